@@ -0,0 +1,6 @@
+g++ src/bench.cpp src/physicsEngine.cpp src/testParticles.cpp src/mortonOrder.cpp src/collisions.cpp src/kepler.cpp src/spacetime.cpp src/scenario.cpp src/snapshot.cpp -o build/bench -Iinclude -fopenmp -O2 -pthread -lbenchmark
+
+# Extra arguments go to Google Benchmark, e.g. --benchmark_filter=ForceKernel.
+# BM_ForceKernelLarge (N = 10^5 and 10^6) takes about an hour on one core; CI runs skip it with
+# --benchmark_filter=-Large
+./build/bench --benchmark_out=build/bench.json --benchmark_out_format=json "$@"
@@ -1,4 +1,4 @@
-g++ src/blackHole.cpp src/rayEngine.cpp -o build/blackHole -Iinclude -lglad -ldl -lGL -lglfw
+g++ src/blackHole.cpp src/rayEngine.cpp src/spacetime.cpp src/physicsEngine.cpp src/testParticles.cpp src/mortonOrder.cpp src/collisions.cpp src/kepler.cpp src/scenario.cpp src/snapshot.cpp src/eventLog.cpp src/shaderCache.cpp src/shaderReloader.cpp -o build/blackHole -Iinclude -fopenmp -O2 -pthread -lglad -ldl -lGL -lglfw
 
 if lspci | grep -iq "nvidia"; then
     echo "Discrete GPU detected. Launching with PRIME offload..."
@@ -0,0 +1,5 @@
+g++ src/cluster.cpp src/distributed.cpp src/transport.cpp src/physicsEngine.cpp src/testParticles.cpp src/mortonOrder.cpp src/collisions.cpp src/kepler.cpp src/scenario.cpp src/snapshot.cpp -o build/cluster -Iinclude -fopenmp -O2 -pthread
+
+# Arguments go to the run, e.g. --ranks 4 --bodies 20000 --steps 200 --check
+# For MPI: mpicxx -DCOSMOS_MPI with the same sources, then mpirun -n 4 ./build/cluster --bodies 20000
+./build/cluster "$@"
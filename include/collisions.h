@@ -0,0 +1,44 @@
+/**
+ * Swept-sphere collision detection and merging for the N-body core.
+ * * Broad phase: sort-and-sweep along the axis with the widest spread, over each body's
+ *   swept bounding box for the step; the sweep runs in parallel over bodies.
+ * * Narrow phase: exact time of first contact for two spheres moving linearly over the step,
+ *   so fast bodies cannot tunnel through each other between steps.
+ * * Merging conserves mass, momentum and volume. The lower-indexed body survives; the other
+ *   becomes an absorbed body (see Bodies::absorbed) riding at the survivor's centre, so
+ *   indices, snapshots and render objects stay valid until the arrays are compacted.
+ */
+
+#ifndef COLLISIONS_H
+#define COLLISIONS_H
+
+#include <cstdint>
+#include <vector>
+
+#include "physicsEngine.h"
+
+struct Collision {
+    uint32_t a, b; // a < b
+    double t;      // time of first contact as a fraction of the step, in [0, 1]
+};
+
+class CollisionDetector {
+public:
+    // Finds every pair whose spheres touch while moving linearly from (x0, y0, z0) to the
+    // current positions. Results are ordered by contact time, then index, for determinism.
+    void find(const Bodies& bodies, const double* x0, const double* y0, const double* z0,
+              std::vector<Collision>& out);
+
+private:
+    struct Interval {
+        double lo, hi;
+        uint32_t body;
+    };
+    std::vector<Interval> intervals;
+};
+
+// Applies collisions in order, skipping any whose bodies were already absorbed this step.
+// Returns the number of merges.
+size_t mergeCollisions(Bodies& bodies, const std::vector<Collision>& collisions);
+
+#endif
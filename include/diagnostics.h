@@ -0,0 +1,45 @@
+/**
+ * Conserved-quantity stream for judging accuracy against speed.
+ * * One row per call to write(): simulated time, the span just advanced, energy terms, momentum,
+ *   angular momentum, their drift relative to the first row, and wall seconds since open().
+ *   Plotting energyError against wall time across timeScale or integrator settings shows what
+ *   each setting costs in accuracy.
+ * * Format follows the file name: JSON Lines (one object per line) for .json or .jsonl, CSV with
+ *   a header line otherwise.
+ * * The values come from PhysicsEngine::metrics, so the engine must run with diagnostics on.
+ *   Output is buffered through a LogChannel; writing a row never touches the bodies.
+ */
+
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "physicsEngine.h"
+
+class DiagnosticsWriter {
+public:
+    DiagnosticsWriter() = default;
+    DiagnosticsWriter(const DiagnosticsWriter&) = delete;
+    DiagnosticsWriter& operator=(const DiagnosticsWriter&) = delete;
+    ~DiagnosticsWriter();
+
+    bool open(const std::string& path);
+    // dt is the simulated span since the previous row; 0 for the first
+    void write(const Diagnostics& d, double dt);
+    uint64_t rows() const { return written; }
+
+private:
+    std::ofstream file;
+    std::unique_ptr<LogChannel> out;
+    bool json = false;
+    uint64_t written = 0;
+    double energy0 = 0.0, angularMomentum0[3] = { 0.0, 0.0, 0.0 };
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif
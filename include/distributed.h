@@ -0,0 +1,76 @@
+/**
+ * class DistributedPhysics
+ * brief Runs one PhysicsEngine per process over a spatial decomposition of the bodies.
+ * * Domains: orthogonal recursive bisection (ORB) of space into one box per rank, cut so each box
+ *   holds an equal share of the measured force-pass time, not just an equal body count. The outer
+ *   faces extend to infinity, so every position has exactly one owner.
+ * * Groups: a top-level body and all of its descendants always live on the same rank, owned by
+ *   the box containing the top-level body, so the parent hierarchy never spans processes.
+ * * Ghosts: before every force pass each rank sends the others a locally essential tree (LET):
+ *   local bodies are bisected into leaves of at most leafSize, and a leaf goes out as one
+ *   monopole when it is small against its distance from the receiving box (size < theta ×
+ *   distance), else body by body. theta = 0 sends every body and reproduces the direct sum.
+ * * Migration: after every step, groups whose top-level body left the box move to its new owner;
+ *   rebalance() recomputes the boxes from the work measured since the previous call, and with
+ *   reorder set also sorts each rank's bodies along a Morton curve (ids follow them).
+ * * note Every rank must call step(), rebalance() and gather() the same number of times.
+ *   Semi-implicit Euler and leapfrog only; collisions and regularization are not supported.
+ */
+
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+#include <cstdint>
+#include <vector>
+
+#include "mortonOrder.h"
+#include "physicsEngine.h"
+#include "transport.h"
+
+struct DomainBox {
+    double lo[3], hi[3];
+    bool contains(double x, double y, double z) const {
+        return x >= lo[0] && x < hi[0] && y >= lo[1] && y < hi[1] && z >= lo[2] && z < hi[2];
+    }
+};
+
+class DistributedPhysics {
+public:
+    PhysicsEngine physics;     // this rank's bodies, plus ghosts during force passes
+    std::vector<uint64_t> ids; // global index of each local body, parallel to physics.bodies
+    double theta = 0.5;
+    size_t leafSize = 32;
+    bool reorder = false; // Morton-sort the local bodies after every rebalance, for the leaf bisection
+
+    // Statistics since construction
+    double computeSeconds = 0.0, commSeconds = 0.0;
+    uint64_t bytesSent = 0, migrated = 0;
+
+    explicit DistributedPhysics(Transport& transport);
+
+    // Splits the full body set by count; every rank passes the same bodies and keeps its share
+    bool distribute(const Bodies& all);
+    bool step(double dt);
+    // New boxes from the work measured since the last rebalance, then migration
+    bool rebalance();
+    // Reassembles every rank's bodies in global order; all ranks receive the result
+    bool gather(Bodies& all);
+
+    int rank() const { return transport.rank(); }
+    const std::vector<DomainBox>& domains() const { return boxes; }
+    size_t ghostCount() const { return physics.ghostMass.size(); }
+
+private:
+    Transport& transport;
+    std::vector<DomainBox> boxes;
+    double workSeconds = 0.0; // force-pass time since the last rebalance
+    bool failed = false;      // a transport error inside a force pass
+    MortonSorter sorter;
+    std::vector<uint32_t> sortOrder;
+
+    int owner(double x, double y, double z) const;
+    void exchangeGhosts();
+    bool migrate();
+};
+
+#endif
@@ -0,0 +1,70 @@
+/**
+ * Precomputed ephemerides: integrate once, replay at any time for free.
+ * * buildEphemeris() steps a PhysicsEngine through the requested span and fits every body's
+ *   position, per axis, with a Chebyshev series on each fixed-length segment (values taken at
+ *   the Chebyshev nodes, so no least-squares solve is needed).
+ * * Layout: a fixed EphemerisHeader followed by one 64-byte aligned block per segment, holding
+ *   bodies × 3 axes × coefficients doubles, so evaluating any time touches a single block.
+ * * EphemerisView maps the file read-only and evaluates positions and velocities (from the
+ *   derivative of the series) at arbitrary times in O(1): scrubbing and reverse playback cost
+ *   no physics.
+ * * Files are written to "<path>.tmp" and renamed, like snapshots.
+ */
+
+#ifndef EPHEMERIS_H
+#define EPHEMERIS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "physicsEngine.h"
+
+constexpr char     EPHEMERIS_MAGIC[8] = { 'C', 'G', 'L', 'E', 'P', 'H', 'M', '\0' };
+constexpr uint32_t EPHEMERIS_VERSION  = 1;
+
+struct EphemerisHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t bodyCount;
+    uint32_t coefficients;  // per axis and segment (polynomial degree + 1)
+    uint32_t reserved;
+    uint64_t segmentCount;
+    double   startTime;     // simulated seconds
+    double   segmentLength; // simulated seconds
+    uint64_t segmentStride; // bytes between segment blocks
+    uint64_t dataOffset;    // byte offset of the first segment block
+    uint64_t fileSize;
+};
+
+// Advances `physics` from its current time over `span` seconds, in steps no longer than
+// `maxStep`, and writes the fitted ephemeris to `path`.
+bool buildEphemeris(const char* path, PhysicsEngine& physics, double span, double segmentLength,
+                    uint32_t coefficients, double maxStep);
+
+// Read-only view of an ephemeris file through mmap.
+struct EphemerisView {
+    const EphemerisHeader* header = nullptr;
+
+    EphemerisView() = default;
+    EphemerisView(const EphemerisView&) = delete;
+    EphemerisView& operator=(const EphemerisView&) = delete;
+    ~EphemerisView();
+
+    bool open(const char* path);
+    void close();
+
+    size_t size() const { return header ? (size_t)header->bodyCount : 0; }
+    double startTime() const { return header ? header->startTime : 0.0; }
+    double endTime() const { return header ? header->startTime + header->segmentCount * header->segmentLength : 0.0; }
+
+    // Writes positions and velocities at time t (clamped to the covered span) into x..vz of `out`,
+    // which must already hold size() bodies.
+    void evaluate(double t, Bodies& out) const;
+
+private:
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+};
+
+#endif
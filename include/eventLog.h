@@ -0,0 +1,76 @@
+/**
+ * Event logs for deterministic, replayable runs.
+ * * A log is plain text, one record per line, so two runs can be diffed directly:
+ *     cosmosgl-events 1
+ *     dt <seconds>                  fixed step of the run
+ *     set <key> <value>             PhysicsEngine setting in force for the whole run
+ *     event <step> <name> <value>   input applied just before step <step>
+ *     hash <step> <hex>             PhysicsEngine::stateHash() after <step> steps
+ * * EventRecorder appends records as a run progresses. EventReplay reads a whole log, hands
+ *   events back at the step they were recorded for and reports the first hash that differs.
+ * * note Replays are bit-exact only for the same binary: compiler flags and the CPU's vector
+ *   width decide the order of each body's force sum.
+ */
+
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "physicsEngine.h"
+
+struct SimEvent {
+    uint64_t step;
+    std::string name;
+    double value;
+};
+
+class EventRecorder {
+public:
+    EventRecorder() = default;
+    EventRecorder(const EventRecorder&) = delete;
+    EventRecorder& operator=(const EventRecorder&) = delete;
+    ~EventRecorder();
+
+    bool open(const char* path, double dt);
+    // Records every setting that changes what step() computes
+    void settings(const PhysicsEngine& physics);
+    void event(uint64_t step, const char* name, double value);
+    void hash(uint64_t step, uint64_t hash);
+    uint64_t lastHashStep() const { return lastHashed; }
+
+private:
+    FILE* out = nullptr;
+    uint64_t lastHashed = UINT64_MAX;
+};
+
+class EventReplay {
+public:
+    double dt = 0.0;
+
+    bool open(const char* path);
+    // Applies the recorded settings; false if one is unknown to this build
+    bool applySettings(PhysicsEngine& physics) const;
+    // Calls `apply` for each event recorded for `step`, in recorded order
+    template <typename F>
+    void eventsAt(uint64_t step, F&& apply) {
+        while (nextEvent < events.size() && events[nextEvent].step < step) ++nextEvent;
+        while (nextEvent < events.size() && events[nextEvent].step == step) apply(events[nextEvent++]);
+    }
+    // Checks `hash` against the recording for `step`, if there is one. Reports the first mismatch.
+    bool verify(uint64_t step, uint64_t hash);
+    uint64_t lastStep() const { return hashes.empty() ? 0 : hashes.back().first; }
+    size_t mismatches() const { return failed; }
+
+private:
+    std::vector<std::pair<std::string, double>> settingsList;
+    std::vector<SimEvent> events;
+    std::vector<std::pair<uint64_t, uint64_t>> hashes;
+    size_t nextEvent = 0, nextHash = 0, failed = 0;
+};
+
+#endif
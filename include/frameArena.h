@@ -0,0 +1,69 @@
+/**
+ * Linear scratch allocator for data that lives for one frame.
+ * * allocate<T>(n) bumps an offset into one block; reset() at the start of the next frame
+ *   releases everything at once. Nothing is freed individually and no destructors run, so
+ *   only trivially destructible types are accepted.
+ * * When a frame needs more than the block holds, the excess comes from overflow blocks and
+ *   the next reset() replaces them all with one block of the combined size: the arena grows
+ *   during the first frames and then stops allocating.
+ * * note Not thread-safe; each thread that needs scratch owns its own arena.
+ */
+
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+class FrameArena {
+public:
+    explicit FrameArena(size_t bytes = size_t(1) << 20) : block(new char[bytes]), blockSize(bytes) {}
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // Uninitialized storage for n objects, valid until the next reset()
+    template <typename T>
+    T* allocate(size_t n) {
+        static_assert(std::is_trivially_destructible<T>::value, "FrameArena never runs destructors");
+        size_t bytes = n * sizeof(T);
+        size_t start = (offset + alignof(T) - 1) & ~(alignof(T) - 1);
+        if (start + bytes <= blockSize) {
+            offset = start + bytes;
+            return reinterpret_cast<T*>(block.get() + start);
+        }
+        // operator new[] storage is aligned for any fundamental type
+        overflow.emplace_back(new char[std::max<size_t>(bytes, 1)]);
+        overflowBytes += bytes;
+        return reinterpret_cast<T*>(overflow.back().get());
+    }
+
+    void reset() {
+        size_t needed = offset + overflowBytes;
+        highWater = std::max(highWater, needed);
+        if (!overflow.empty()) {
+            overflow.clear();
+            overflowBytes = 0;
+            blockSize = std::max(blockSize * 2, needed + needed / 2);
+            block.reset(new char[blockSize]);
+        }
+        offset = 0;
+    }
+
+    size_t used() const { return offset + overflowBytes; }
+    size_t capacity() const { return blockSize; }
+    size_t peak() const { return std::max(highWater, used()); }
+
+private:
+    std::unique_ptr<char[]> block;
+    size_t blockSize;
+    size_t offset = 0;
+    std::vector<std::unique_ptr<char[]>> overflow;
+    size_t overflowBytes = 0;
+    size_t highWater = 0;
+};
+
+#endif
@@ -0,0 +1,99 @@
+/**
+ * GPU zones for the profiler, timed with GL timestamp queries.
+ * * PROFILE_GPU_ZONE("name") brackets the GL commands issued in the enclosing scope.
+ * * Results arrive a few frames late; PROFILE_GPU_COLLECT() once per frame moves every finished
+ *   query onto a "GPU" track, converted to the CPU clock so it lines up in exported traces.
+ * * note Needs a current GL context. Compiles to nothing unless COSMOS_PROFILE is defined.
+ */
+
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include "profiler.h"
+
+#ifdef COSMOS_PROFILE
+
+#include <glad/glad.h>
+
+class GpuProfiler {
+public:
+    static constexpr size_t RING = 256; // zones in flight
+
+    size_t begin(const char* name) {
+        if (!initialized) init();
+        if (head - tail == RING) return SIZE_MAX; // GPU is too far behind; drop the zone
+        Query& q = queries[head % RING];
+        q.name = name;
+        glQueryCounter(q.begin, GL_TIMESTAMP);
+        return head++;
+    }
+
+    void end(size_t zone) {
+        if (zone != SIZE_MAX) glQueryCounter(queries[zone % RING].end, GL_TIMESTAMP);
+    }
+
+    void collect() {
+        while (tail != head) {
+            Query& q = queries[tail % RING];
+            GLint available = 0;
+            glGetQueryObjectiv(q.end, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) break;
+
+            GLuint64 b = 0, e = 0;
+            glGetQueryObjectui64v(q.begin, GL_QUERY_RESULT, &b);
+            glGetQueryObjectui64v(q.end, GL_QUERY_RESULT, &e);
+            track->record(q.name, (int64_t)b - offset, (int64_t)e - offset);
+            ++tail;
+        }
+    }
+
+private:
+    struct Query {
+        const char* name;
+        GLuint begin, end;
+    };
+
+    Query queries[RING];
+    size_t head = 0, tail = 0;
+    bool initialized = false;
+    int64_t offset = 0; // GPU timestamp minus profiler::now()
+    ProfileTrack* track = nullptr;
+
+    void init() {
+        GLuint ids[2 * RING];
+        glGenQueries(2 * RING, ids);
+        for (size_t i = 0; i < RING; ++i) {
+            queries[i].begin = ids[2 * i];
+            queries[i].end = ids[2 * i + 1];
+        }
+        GLint64 gpuNow = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+        offset = gpuNow - profiler::now();
+        track = profiler::track("GPU");
+        initialized = true;
+    }
+};
+
+// One per process: both demos render from a single context
+inline GpuProfiler gpuProfiler;
+
+class GpuProfileZone {
+public:
+    explicit GpuProfileZone(const char* name) : zone(gpuProfiler.begin(name)) {}
+    ~GpuProfileZone() { gpuProfiler.end(zone); }
+
+private:
+    size_t zone;
+};
+
+#define PROFILE_GPU_ZONE(name) GpuProfileZone PROFILE_CONCAT(gpuProfileZone_, __LINE__)(name)
+#define PROFILE_GPU_COLLECT() gpuProfiler.collect()
+
+#else
+
+#define PROFILE_GPU_ZONE(name) ((void)0)
+#define PROFILE_GPU_COLLECT() ((void)0)
+
+#endif
+
+#endif
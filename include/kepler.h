@@ -0,0 +1,18 @@
+/**
+ * Two-body propagation in universal variables.
+ * * keplerDrift() advances a relative position and velocity exactly along their conic, for
+ *   elliptic, parabolic and hyperbolic orbits alike, so a bound pair can be stepped across many
+ *   periods at once without losing energy.
+ * * The universal Kepler equation is solved by Laguerre–Conway iteration on Stumpff functions,
+ *   which converges from a crude first guess even for very eccentric orbits.
+ * * note Contains no OpenGL; shared by the N-body core's close-pair regularization.
+ */
+
+#ifndef KEPLER_H
+#define KEPLER_H
+
+// Advances relative position r and velocity v (SI units) by dt under gravitational parameter
+// mu = G (m1 + m2). Returns false, leaving r and v untouched, if the solve does not converge.
+bool keplerDrift(double mu, double r[3], double v[3], double dt);
+
+#endif
@@ -0,0 +1,43 @@
+/**
+ * class MortonSorter
+ * brief Space-filling-curve order for the body arrays, so bodies close in space are close in memory.
+ * * Keys: each top-level body's position is quantized to 21 bits per axis inside the cube bounding
+ *   all top-level bodies, and the bits are interleaved (Morton / Z-order), so nearby bodies get
+ *   nearby keys.
+ * * Sort: least-significant-digit radix sort, 8 bits per pass, with per-thread histograms over
+ *   contiguous blocks; stable, so the result never depends on the thread count. Passes above the
+ *   highest set key bit are skipped.
+ * * Groups: children are listed straight after their top-level body, in their existing order, so
+ *   parents still precede children and a planet's moons share its cache lines.
+ * * The order is for Bodies::permute; PhysicsEngine::sortBodies applies it, and reorderInterval
+ *   does so every few steps. Scratch is kept between calls.
+ */
+
+#ifndef MORTON_ORDER_H
+#define MORTON_ORDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Bodies;
+
+// Interleaves the low 21 bits of x, y and z as ...z1y1x1z0y0x0
+uint64_t mortonKey(uint32_t x, uint32_t y, uint32_t z);
+
+class MortonSorter {
+public:
+    // Fills order with a permutation of every body index, for Bodies::permute
+    void order(const Bodies& bodies, std::vector<uint32_t>& out);
+
+    // Stable sort of values by keys, both reordered in place
+    void radixSort(std::vector<uint64_t>& keys, std::vector<uint32_t>& values);
+
+private:
+    std::vector<uint64_t> keys, keysTmp;
+    std::vector<uint32_t> roots, valuesTmp;
+    std::vector<uint32_t> root, groupStart, members;
+    std::vector<size_t> histogram;
+};
+
+#endif
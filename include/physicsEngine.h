@@ -0,0 +1,225 @@
+/**
+ * struct PhysicsEngine
+ * brief Newtonian N-body core shared by the simulations; step() does not allocate once its scratch is
+ *   sized (permute(), compact() and sortBodies() do, when called).
+ * * Bodies are stored as structure-of-arrays so the force kernel vectorizes:
+ * - Force pass: every acceleration is computed from the same positions (OpenMP over i, SIMD over j).
+ * - Update pass: velocities and positions are advanced afterwards, so results do not depend on body order.
+ * - Hierarchy: a body with a parent feels only its parent's pull on top of the parent's own
+ *   acceleration, and exerts no force itself (moons and other subsystems).
+ * - Wisdom–Holman: orbits about the most massive body, and every child's orbit about its parent, are
+ *   advanced analytically; only the interactions between top-level bodies are integrated, so steps can
+ *   be a sizeable fraction of the shortest orbital period.
+ * - Softening: None, Plummer or cubic spline, each compiled into its own force kernel.
+ * - Regularization: mutually nearest pairs inside regularizationRadius move on exact Kepler orbits
+ *   while the rest of the system acts on them as a perturbation, so close binaries stay stable at
+ *   large steps.
+ * - Collisions: optional swept-sphere detection after each step; touching bodies merge (collisions.h).
+ * - Test particles: massless ring and belt particles (testParticles.h) feel every massive body and
+ *   are stepped alongside them at a cost linear in their number.
+ * - Ghosts: extra point sources (ghostX … ghostMass) that pull on local bodies but are not integrated,
+ *   refreshed through beforeForces; this is how other processes' bodies enter (distributed.h).
+ * - Handles: BodyHandle names a body independently of its index, so bodies can be reordered for
+ *   locality or compacted after merges without breaking anything that refers to them.
+ * - Locality: with reorderInterval set, step() periodically sorts the bodies along a Morton curve so
+ *   spatial neighbours (collision sweeps, tree builds) sit close together in memory.
+ * - Diagnostics: with diagnostics on, the force kernel also sums each body's potential from the pair terms
+ *   it already computes, and `metrics` gets energy, momentum and angular momentum every step for O(N).
+ * - Determinism: every parallel loop writes per-body results and any cross-body sums run in a fixed
+ *   order, so the same dt sequence reproduces the same bits whatever the thread count (stateHash()).
+ * - Logging: optional, through a LogChannel that buffers output instead of flushing per line.
+ * * note Contains no OpenGL; it can be linked into headless tools.
+ */
+
+#ifndef PHYSICS_ENGINE_H
+#define PHYSICS_ENGINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "testParticles.h"
+
+enum class Softening {
+    None,    // Newtonian, pairs inside minDistance masked out
+    Plummer, // 1 / (r² + ε²): smooth everywhere, weakens forces slightly at all ranges
+    Spline   // cubic-spline kernel: exactly Newtonian beyond 2.8 ε, finite at contact
+};
+
+struct Collision;
+class CollisionDetector;
+class MortonSorter;
+
+enum class Integrator {
+    SemiImplicitEuler, // kick then drift, one force pass per step
+    Leapfrog,          // kick-drift-kick, reuses the previous step's forces
+    WisdomHolman       // democratic-heliocentric mixed variables: exact Kepler drifts, interactions as kicks
+};
+
+// Names one body wherever reordering or compaction moves it; see Bodies::permute
+struct BodyHandle {
+    uint32_t slot = UINT32_MAX;
+    uint32_t generation = 0;
+    bool operator==(const BodyHandle& o) const { return slot == o.slot && generation == o.generation; }
+    bool operator!=(const BodyHandle& o) const { return !(*this == o); }
+};
+
+// Handle slot → current body index. A plain copy resolves handles against the body order at the
+// time it was taken, which is how render snapshots resolve them.
+struct BodySlots {
+    std::vector<uint32_t> index;      // body index per slot, UINT32_MAX while free
+    std::vector<uint32_t> generation; // bumped every time a slot is freed
+    std::vector<uint32_t> freeSlots;
+
+    // -1 for a handle whose body is gone
+    int find(BodyHandle h) const {
+        if (h.slot >= index.size() || generation[h.slot] != h.generation || index[h.slot] == UINT32_MAX) return -1;
+        return (int)index[h.slot];
+    }
+};
+
+struct Bodies {
+    std::vector<double> x, y, z;
+    std::vector<double> vx, vy, vz;
+    std::vector<double> ax, ay, az;
+    std::vector<double> mass, radius;
+    std::vector<int> parent; // index of the body orbited, -1 for top-level; always lower than the child's
+    std::vector<uint8_t> merged; // 1 once a collision has absorbed the body into its parent
+    std::vector<uint32_t> slot; // handle slot of each body
+    BodySlots slots;
+
+    size_t size() const { return x.size(); }
+    void reserve(size_t n);
+    void resize(size_t n);
+    void clear();
+    size_t add(double px, double py, double pz, double velX, double velY, double velZ, double m, double r, int parentIndex = -1);
+
+    BodyHandle handle(size_t i) const { return { slot[i], slots.generation[slot[i]] }; }
+    int find(BodyHandle h) const { return slots.find(h); }
+
+    // Moves body order[k] to index k, remapping parents and handles; parents must still precede
+    // their children. Bodies left out are removed and their handles go stale, except absorbed
+    // bodies, whose handles then resolve to the body they merged into.
+    void permute(const std::vector<uint32_t>& order);
+
+    // Merged into its parent by a collision (mergeCollisions): massless, zero radius and carried at the
+    // parent's centre. Flagged explicitly, since a massless point child is also a valid scenario body.
+    bool absorbed(size_t i) const { return merged[i] != 0; }
+
+private:
+    uint32_t acquireSlot(uint32_t index);
+    void releaseSlot(uint32_t s);
+};
+
+// Conserved quantities of the top-level bodies, which form the closed system: children and ghosts
+// are left out, as they are as sources. Potential energy uses the same softened pair terms as the forces.
+struct Diagnostics {
+    double time = 0.0; // simulated time the values describe
+    double kinetic = 0.0, potential = 0.0;
+    double momentum[3] = { 0.0, 0.0, 0.0 };
+    double angularMomentum[3] = { 0.0, 0.0, 0.0 }; // about the origin
+    uint64_t samples = 0; // steps measured since diagnostics was turned on
+
+    double energy() const { return kinetic + potential; }
+};
+
+// Formats log lines into memory and writes them out in large chunks.
+struct LogChannel {
+    std::ostream& out;
+    std::string buffer;
+    size_t flushThreshold;
+
+    explicit LogChannel(std::ostream& stream, size_t threshold = 1 << 16);
+    ~LogChannel();
+
+    void print(const char* fmt, ...);
+    void flush();
+};
+
+struct PhysicsEngine {
+    Bodies bodies;
+    double gravConst = 6.67430e-11;
+    double minDistance = 0.0; // pairs closer than this exert no force (Softening::None only)
+    Softening softening = Softening::None;
+    double softeningLength = 0.0;      // ε in metres; 0 disables softening
+    double regularizationRadius = 0.0; // close pairs inside this many metres are solved as two-body orbits; 0 disables
+    Integrator integrator = Integrator::SemiImplicitEuler;
+    double time = 0.0;
+    LogChannel* log = nullptr;
+    bool collisions = false;  // merge bodies whose spheres touch during a step
+    TestParticles particles;  // massless, stepped with the bodies
+    std::vector<double> ghostX, ghostY, ghostZ, ghostMass; // sources owned elsewhere
+    std::function<void()> beforeForces;                     // runs at the start of every force pass
+    size_t mergeCount = 0;    // merges since construction
+    size_t keplerFailures = 0; // two-body drifts (Wisdom–Holman, regularized pairs) that fell back to a straight line; the first is reported on cerr
+    bool diagnostics = false; // accumulate potential energy in the force pass and keep `metrics` current
+    Diagnostics metrics;      // as of the end of the last step; semi-implicit Euler: its start, where it measures forces
+    // Steps between Morton reorders of the bodies (sortBodies, which allocates); 0 never. Reordering moves bodies
+    // between indices, so trajectories, ephemeris builds, snapshots, checkpoints and event logs, which list bodies
+    // by scenario index, refuse to attach while it is set (as distributed runs do)
+    size_t reorderInterval = 0;
+
+    PhysicsEngine();
+    ~PhysicsEngine();
+    PhysicsEngine(const PhysicsEngine&) = delete;
+    PhysicsEngine& operator=(const PhysicsEngine&) = delete;
+
+    void computeAccelerations();
+    void step(double dt);
+    // Call after editing bodies directly so cached forces are not reused
+    void markBodiesChanged() { accelerationsValid = false; sourceMass.clear(); particles.accelerationsValid = false; }
+    // Call after moving bodies between indices when each body's stored acceleration is still correct
+    void markBodiesMoved() { sourceMass.clear(); }
+    // Bodies::permute that also remaps the per-index state cached between steps (central body,
+    // regularized pairs), so stored accelerations stay usable
+    void permute(const std::vector<uint32_t>& order);
+    // Drops bodies absorbed by collisions; handles to them then resolve to their absorbers. Returns how many went.
+    size_t compact();
+    // Reorders the bodies along a Morton curve (mortonOrder.h) so neighbours in space are neighbours in memory
+    void sortBodies();
+    size_t regularizedPairs() const { return binaries.size(); }
+    // FNV-1a over every body and particle array and the time; equal hashes mean bit-identical state
+    uint64_t stateHash() const;
+
+private:
+    bool accelerationsValid = false;
+    std::vector<double> sourceMass; // mass of top-level bodies, 0 for children
+    std::vector<int> children;      // indices with a parent, in ascending order
+    std::vector<std::pair<int, int>> binaries; // regularized pairs from the last force pass, i < j
+    std::vector<int> nearest;
+    void updateSources();
+    template <Softening S, bool Potential> void forceKernel();
+    std::vector<double> potential; // Σ_j m_j φ(r_ij) per top-level body, filled when diagnostics is on
+    void measureMotion();
+    void findBinaries();
+    void kick(double dt);
+    void drift(double dt);
+    void countKeplerFailures(size_t failures);
+
+    // Wisdom–Holman state: heliocentric positions and barycentric velocities for top-level bodies,
+    // positions and velocities relative to the parent for children
+    int central = -1; // dominant body, excluded from the interaction forces
+    std::vector<double> relX, relY, relZ, relVx, relVy, relVz;
+    void wisdomHolmanStep(double dt);
+
+    // Start-of-step positions for the swept test
+    std::vector<double> startX, startY, startZ;
+    std::unique_ptr<CollisionDetector> detector;
+    std::vector<Collision> contacts;
+    void resolveCollisions();
+
+    std::unique_ptr<MortonSorter> sorter;
+    std::vector<uint32_t> sortOrder;
+    size_t stepsSinceSort = 0;
+
+    // Every massive body, with G folded into the mass, for the particle kernel
+    std::vector<double> massiveX, massiveY, massiveZ, massiveGm;
+    void accelerateParticles();
+};
+
+#endif
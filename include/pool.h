@@ -0,0 +1,130 @@
+/**
+ * Object pool with stable addresses and generational handles.
+ * * Objects live in fixed-size chunks that never move, so a pointer to one stays valid until
+ *   that object is destroyed, however many are created after it (unlike a vector).
+ * * Destroyed slots go on a free list and are reused before a new chunk is allocated; each
+ *   reuse bumps the slot's generation, so a Handle to a destroyed object resolves to nullptr
+ *   instead of to whatever took its place.
+ * * Iteration visits live objects in slot order.
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+template <typename T, size_t ChunkSize = 64>
+class Pool {
+    struct Slot {
+        alignas(T) unsigned char storage[sizeof(T)];
+        uint32_t generation = 0;
+        bool live = false;
+        T* object() { return std::launder(reinterpret_cast<T*>(storage)); }
+    };
+
+public:
+    struct Handle {
+        uint32_t index = UINT32_MAX;
+        uint32_t generation = 0;
+        bool operator==(const Handle& o) const { return index == o.index && generation == o.generation; }
+        bool operator!=(const Handle& o) const { return !(*this == o); }
+    };
+
+    Pool() = default;
+    Pool(const Pool&) = delete;
+    Pool& operator=(const Pool&) = delete;
+    ~Pool() { clear(); }
+
+    template <typename... Args>
+    Handle create(Args&&... args) {
+        uint32_t index;
+        if (!freeSlots.empty()) {
+            index = freeSlots.back();
+            freeSlots.pop_back();
+        } else {
+            index = (uint32_t)slotCount++;
+            if (index / ChunkSize == chunks.size()) chunks.emplace_back(new Slot[ChunkSize]);
+        }
+        Slot& s = slot(index);
+        new (s.storage) T(std::forward<Args>(args)...);
+        s.live = true;
+        ++liveCount;
+        return { index, s.generation };
+    }
+
+    void destroy(Handle h) {
+        if (!get(h)) return;
+        Slot& s = slot(h.index);
+        s.object()->~T();
+        s.live = false;
+        ++s.generation;
+        --liveCount;
+        freeSlots.push_back(h.index);
+    }
+
+    // nullptr once the object has been destroyed, even if its slot was reused
+    T* get(Handle h) {
+        if (h.index >= slotCount) return nullptr;
+        Slot& s = slot(h.index);
+        return s.live && s.generation == h.generation ? s.object() : nullptr;
+    }
+    T& operator[](Handle h) { return *get(h); }
+
+    void clear() {
+        for (uint32_t i = 0; i < slotCount; ++i) {
+            Slot& s = slot(i);
+            if (s.live) {
+                s.object()->~T();
+                s.live = false;
+                ++s.generation;
+            }
+        }
+        freeSlots.clear();
+        for (uint32_t i = (uint32_t)slotCount; i-- > 0;) freeSlots.push_back(i);
+        liveCount = 0;
+    }
+
+    size_t size() const { return liveCount; }
+    bool empty() const { return liveCount == 0; }
+
+    class iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = T*;
+        using reference = T&;
+
+        iterator(Pool* pool, size_t index) : pool(pool), index(index) { skip(); }
+        T& operator*() const { return *pool->slot(index).object(); }
+        T* operator->() const { return pool->slot(index).object(); }
+        iterator& operator++() { ++index; skip(); return *this; }
+        bool operator==(const iterator& o) const { return index == o.index; }
+        bool operator!=(const iterator& o) const { return index != o.index; }
+
+    private:
+        Pool* pool;
+        size_t index;
+        void skip() { while (index < pool->slotCount && !pool->slot(index).live) ++index; }
+    };
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, slotCount); }
+    T& front() { return *begin(); }
+
+private:
+    std::vector<std::unique_ptr<Slot[]>> chunks;
+    std::vector<uint32_t> freeSlots;
+    size_t slotCount = 0;
+    size_t liveCount = 0;
+
+    Slot& slot(size_t index) { return chunks[index / ChunkSize][index % ChunkSize]; }
+};
+
+#endif
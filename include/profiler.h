@@ -0,0 +1,196 @@
+/**
+ * Scoped-zone CPU profiler.
+ * * PROFILE_ZONE("name") records the enclosing scope into a ring buffer owned by the calling
+ *   thread: no locks and no allocation after a thread's first zone. Names must be string literals.
+ *   Readers skip any event the writer has wrapped around onto, so they never see a torn one.
+ * * PROFILE_SUMMARY(frames) returns a one-line per-zone breakdown (ms per frame) of everything
+ *   completed since the previous call, for the window title.
+ * * PROFILE_EXPORT(path) writes the contents of every ring as Chrome trace JSON, which also
+ *   opens in Perfetto (ui.perfetto.dev) and chrome://tracing.
+ * * note Everything here compiles to nothing unless COSMOS_PROFILE is defined.
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <string>
+
+#ifdef COSMOS_PROFILE
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct ProfileEvent {
+    const char* name;
+    int64_t start, end; // ns since the profiler epoch
+};
+
+// One timeline: a thread, or a pseudo-thread such as the GPU. Single writer; readers never block it.
+// Each slot carries the sequence number of the event in it, so a reader that raced the writer wrapping
+// around onto that slot sees the number change and skips the event instead of using a torn one.
+struct ProfileTrack {
+    static constexpr size_t CAPACITY = size_t(1) << 16;
+
+    struct Slot {
+        std::atomic<uint64_t> sequence{ 0 }; // event index + 1 once complete, 0 while being written
+        std::atomic<const char*> name{ nullptr };
+        std::atomic<int64_t> start{ 0 }, end{ 0 };
+    };
+
+    std::string label;
+    uint32_t id = 0;
+    std::atomic<uint64_t> written{ 0 };
+    uint64_t summarized = 0; // consumer cursor for profiler::summary()
+    Slot slots[CAPACITY];
+
+    void record(const char* name, int64_t start, int64_t end) {
+        uint64_t n = written.load(std::memory_order_relaxed);
+        Slot& s = slots[n & (CAPACITY - 1)];
+        s.sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        s.name.store(name, std::memory_order_relaxed);
+        s.start.store(start, std::memory_order_relaxed);
+        s.end.store(end, std::memory_order_relaxed);
+        s.sequence.store(n + 1, std::memory_order_release);
+        written.store(n + 1, std::memory_order_release);
+    }
+
+    // Event k, unless the writer has overwritten it (or is overwriting it) since it was recorded
+    bool read(uint64_t k, ProfileEvent& out) const {
+        const Slot& s = slots[k & (CAPACITY - 1)];
+        if (s.sequence.load(std::memory_order_acquire) != k + 1) return false;
+        out = { s.name.load(std::memory_order_relaxed), s.start.load(std::memory_order_relaxed), s.end.load(std::memory_order_relaxed) };
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return s.sequence.load(std::memory_order_relaxed) == k + 1;
+    }
+};
+
+namespace profiler {
+
+inline const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+inline int64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+// Tracks outlive their threads so a trace can still be exported after workers exit
+inline std::mutex tracksMutex;
+inline std::vector<std::unique_ptr<ProfileTrack>> tracks;
+
+inline ProfileTrack* track(const std::string& label) {
+    std::lock_guard<std::mutex> lock(tracksMutex);
+    tracks.push_back(std::make_unique<ProfileTrack>());
+    tracks.back()->id = (uint32_t)tracks.size();
+    tracks.back()->label = label.empty() ? "thread " + std::to_string(tracks.size()) : label;
+    return tracks.back().get();
+}
+
+inline ProfileTrack& local() {
+    thread_local ProfileTrack* t = track("");
+    return *t;
+}
+
+// Optional: label the calling thread's timeline in exported traces. Call before its first zone.
+inline void nameThread(const char* label) {
+    ProfileTrack& t = local();
+    std::lock_guard<std::mutex> lock(tracksMutex);
+    t.label = label;
+}
+
+inline std::string summary(int frames) {
+    struct Zone { const char* name; int64_t total; };
+    std::vector<Zone> zones;
+    {
+        std::lock_guard<std::mutex> lock(tracksMutex);
+        for (auto& t : tracks) {
+            uint64_t end = t->written.load(std::memory_order_acquire);
+            uint64_t begin = std::max(t->summarized, end > ProfileTrack::CAPACITY ? end - ProfileTrack::CAPACITY : 0);
+            for (uint64_t k = begin; k < end; ++k) {
+                ProfileEvent e;
+                if (!t->read(k, e)) continue;
+                auto it = std::find_if(zones.begin(), zones.end(), [&](const Zone& z) { return strcmp(z.name, e.name) == 0; });
+                if (it == zones.end()) zones.push_back({ e.name, e.end - e.start });
+                else it->total += e.end - e.start;
+            }
+            t->summarized = end;
+        }
+    }
+    std::sort(zones.begin(), zones.end(), [](const Zone& a, const Zone& b) { return a.total > b.total; });
+
+    std::string out;
+    char buf[96];
+    for (const Zone& z : zones) {
+        snprintf(buf, sizeof(buf), "%s%s %.2f", out.empty() ? "" : " | ", z.name, z.total / 1e6 / std::max(frames, 1));
+        out += buf;
+    }
+    return out.empty() ? out : out + " ms/frame";
+}
+
+inline bool exportChromeTrace(const char* path) {
+    std::ofstream out(path);
+    if (!out) {
+        fprintf(stderr, "Could not write trace: %s\n", path);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(tracksMutex);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    char buf[256];
+    for (auto& t : tracks) {
+        snprintf(buf, sizeof(buf), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                 first ? "" : ",\n", t->id, t->label.c_str());
+        out << buf;
+        first = false;
+
+        uint64_t end = t->written.load(std::memory_order_acquire);
+        uint64_t begin = end > ProfileTrack::CAPACITY ? end - ProfileTrack::CAPACITY : 0;
+        for (uint64_t k = begin; k < end; ++k) {
+            ProfileEvent e;
+            if (!t->read(k, e)) continue;
+            snprintf(buf, sizeof(buf), ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                     e.name, t->id, e.start / 1e3, (e.end - e.start) / 1e3);
+            out << buf;
+        }
+    }
+    out << "\n]}\n";
+    return true;
+}
+
+} // namespace profiler
+
+class ProfileZone {
+public:
+    explicit ProfileZone(const char* name) : name(name), start(profiler::now()) {}
+    ~ProfileZone() { profiler::local().record(name, start, profiler::now()); }
+
+private:
+    const char* name;
+    int64_t start;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone_, __LINE__)(name)
+#define PROFILE_THREAD(label) profiler::nameThread(label)
+#define PROFILE_SUMMARY(frames) profiler::summary(frames)
+#define PROFILE_EXPORT(path) profiler::exportChromeTrace(path)
+
+#else
+
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_THREAD(label) ((void)0)
+#define PROFILE_SUMMARY(frames) std::string()
+#define PROFILE_EXPORT(path) ((void)0)
+
+#endif
+
+#endif
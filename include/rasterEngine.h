@@ -3,9 +3,23 @@
  * brief Orchestrates the OpenGL context, N-body physics simulation, and 3D rendering.
  * * The Engine class acts as the central hub for the solar system simulation. It handles:
  * - Window Management: Initializes GLFW and GLAD context for OpenGL 4.6.
- * - Physics: Implements Newtonian gravitation for all celestial bodies using Euler integration.
+ * - Physics: Steps a PhysicsEngine (Newtonian gravity, semi-implicit Euler) on its own thread, publishing RenderState
+ *   snapshots through a lock-free triple buffer so neither a slow step nor a slow frame stalls the other.
+ * - Scenarios: Loads bodies from CSV/JSON/binary files; bulk bodies go straight into the physics arrays.
+ * - Particles: rings and belts with a particle count become massless test particles, drawn as
+ *   instanced point sprites of constant screen size.
+ * - Persistence: Saves and restores simulation state as binary snapshots, optionally checkpointing in the background.
+ * - Output: Optionally streams compressed trajectories to disk on an I/O thread for offline analysis, and
+ *   energy and momentum drift per tick as CSV or JSON Lines (diagnostics.h).
+ * - Determinism: with a fixed step, results depend only on the number of steps taken, never on frame timing;
+ *   runs can be recorded to an event log and replayed headless, bit for bit, as a benchmark.
+ * - Playback: Optionally replays a precomputed Chebyshev ephemeris instead of integrating, with looping,
+ *   scrubbing and reverse playback (negative timeScale).
  * - Camera Control: Manages an orbital camera with dragging (rotation), panning, and scroll-based zooming.
- * - Scene Graph: Stores and manages unique pointers to Star and Planet objects, ensuring proper GPU resource cleanup.
+ * - Scene Graph: Stars, planets and satellites live in pools (pool.h), so their addresses stay valid as more are
+ *   added, and refer to their bodies (as do the camera targets) by BodyHandle rather than index, so physics may
+ *   reorder or compact its arrays; per-frame temporaries come from a linear arena (frameArena.h) reset every frame, and the steady-state
+ *   frame loop performs no heap allocations.
  * * note Physics calculations use a gravitational constant G = 6.67430e-11 and support time scaling.
  */
 
@@ -19,12 +33,32 @@
 #include <string> 
 #include <fstream> 
 #include <deque>
+#include <unordered_map>
+#include <atomic>
+#include <thread>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+#include "physicsEngine.h"
+#include "snapshot.h"
+#include "scenario.h"
+#include "trajectory.h"
+#include "diagnostics.h"
+#include "ephemeris.h"
+#include "eventLog.h"
+#include "tripleBuffer.h"
+#include "trail.h"
+#include "pool.h"
+#include "frameArena.h"
+#include "profiler.h"
+#include "gpuProfiler.h"
+#include "shaderCache.h"
+#include "shaderReloader.h"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -37,14 +71,20 @@
 using namespace std;
 using namespace glm;
 
+// Resolved through the render snapshot each frame, so it follows its body however physics reorders them
 struct CameraTarget {
-    vec3* position;
+    BodyHandle body;
     double radius;
     string name;
 };
 
-struct Trail {
-    deque<vec3> points;
+// Immutable view of the simulation handed from the physics thread to the renderer
+struct RenderState {
+    vector<vec3> positions;
+    vector<vec3> velocities;
+    vector<vec3> particles;
+    BodySlots slots; // resolves BodyHandles to indices into positions and velocities
+    double time = 0.0;
 };
 
 struct Star {
@@ -58,6 +98,7 @@ struct Star {
     vector<GLfloat> vertices;
     vector<GLuint> indices;
     GLuint VAO, VBO, EBO;
+    BodyHandle body; // into Engine::physics.bodies
 
     Star(vec3 pos, double m, double r, vec3 c, double b, vec3 v);
 };
@@ -74,6 +115,7 @@ struct Satellite {
     vector<GLfloat> vertices;
     vector<GLuint> indices;
     GLuint VAO, VBO, EBO;
+    BodyHandle body; // into Engine::physics.bodies
 
     Satellite(vec3 pos, double m, double r, vec3 c, double rS, vec3 v);
 };
@@ -100,22 +142,15 @@ struct Planet {
     vec3 initialVelocity;
     Trail trail;
     vector<Ring> rings;
-    vector<Satellite> satellites;
+    vector<Satellite*> satellites; // owned by Engine's satellite pool
     vector<GLfloat> vertices;
     vector<GLuint> indices;
     GLuint VAO, VBO, EBO;
+    BodyHandle body; // into Engine::physics.bodies
 
     Planet(vec3 pos, double m, double r, vec3 c, double rS, vec3 v);
 };
 
-struct CelestialBody {
-    vec3* position;
-    vec3 velocity;
-    double mass;
-
-    CelestialBody(vec3* pos, vec3 vel, double m) : position(pos), velocity(vel), mass(m) {}
-};
-
 class Engine {
 private:
     int WIDTH = 800;
@@ -125,14 +160,74 @@ private:
     mat4 projection;
     mat4 view;
 
+    ShaderCache shaderCache;
+    unique_ptr<ShaderReloader> shaderReloader;
     string getFileContents(const char* filename);
     GLuint createShader(const char* vertexFile, const char* fragmentFile);
 
-    GLuint uboWindowData, trailShaderID, starShaderID, planetShaderID, ringShaderID, satelliteShaderID;
+    // Scratch for one frame's uploads; reset at the top of run()
+    FrameArena frameArena;
+    GLuint trailVAO = 0, trailVBO = 0;
+    size_t trailCapacity = 0;
+
+    GLuint uboWindowData, trailShaderID, starShaderID, planetShaderID, ringShaderID, satelliteShaderID, particleShaderID;
+
+    Pool<Star> stars;
+    Pool<Planet> planets;
+    Pool<Satellite> satellites;
+    unique_ptr<Checkpointer> checkpointer;
+    string checkpointPath;
+    unique_ptr<TrajectoryWriter> trajectory;
+    unique_ptr<DiagnosticsWriter> diagnostics;
+
+    // Ephemeris playback replaces integration on the physics thread
+    unique_ptr<EphemerisView> ephemeris;
+    double playbackTime = 0.0;
+    atomic<double> pendingScrub{ 0.0 };
+    void playbackTick(double dt);
+
+    // Deterministic mode: whole fixed steps only, the remainder of each tick carries over
+    double stepDebt = 0.0;
+    uint64_t stepCount = 0;
+    unique_ptr<EventRecorder> recorder;
+    void fixedStep();
+
+    // Merged bodies are dropped from the arrays when no output needs indices to match the scenario
+    size_t compactedMerges = 0;
+    void compactBodies();
+    // False, with a message naming `what`, if physics reorders bodies (reorderInterval); snapshots,
+    // checkpoints, trajectories and event logs all list bodies by scenario index
+    bool bodyOrderFixed(const char* what) const;
+
+    // Physics-only bodies (asteroids, debris) drawn as points rather than meshes
+    vector<BodyHandle> pointBodies;
+    GLuint pointVAO = 0, pointVBO = 0;
+    size_t pointCapacity = 0;
+
+    // Test particles: one quad instanced per particle; colours are uploaded only when particles are added
+    vector<u8vec4> particleColors;
+    size_t particleColorsUploaded = 0;
+    GLuint particleVAO = 0, particleQuadVBO = 0, particlePositionVBO = 0, particleColorVBO = 0;
+    size_t particleCapacity = 0;
+
+    // Physics thread. Everything that touches `physics` while it runs must go through stopPhysics() first.
+    thread physicsThread;
+    atomic<bool> physicsRunning{ false };
+    TripleBuffer<RenderState> renderState;
+
+    void physicsLoop();
+    void startPhysics();
+    void stopPhysics();
+    void captureRenderState(RenderState& state) const;
+    void applyRenderState(const RenderState& state);
+    void syncFromPhysics();
+    void updateTrails();
+    size_t orbitTrailPoints(double distance, double speed) const;
 
-    vector<unique_ptr<Star>> stars;
-    vector<unique_ptr<Planet>> planets;
-    vector<CelestialBody> bodies;
+    // Window title statistics, refreshed once a second
+    double lastTitleTime = 0.0;
+    int titleFrames = 0;
+    void updateTitle();
 
 public:
     float distance = 5.0e10f; 
@@ -144,11 +239,15 @@ public:
     float lastFrame = 0.0f;
     float currentFrame = 0.0f;
     float deltaTime = 0.0f;
-    float timeScale = 86400.0f;
+    atomic<float> timeScale{ 86400.0f };
+    double maxStep = 0.0; // upper bound on one integrator step in simulated seconds; 0 = one step per tick
+    double fixedDt = 0.0; // > 0: deterministic mode, every integrator step exactly this long
+    uint64_t hashInterval = 100; // steps between state hashes in a recorded event log
     float scaleFactor = 1.0f;
     vec3 focusTarget = vec3(5.0f);
     vector<CameraTarget> registry;
     int focusIndex = 0;
+    PhysicsEngine physics;
 
     GLFWwindow* window;
 
@@ -159,15 +258,32 @@ public:
     void updateCameraFocus();
 
     void updateMatrices();
-    Star* addStar(unique_ptr<Star> st);
+    Star* addStar(vec3 pos, double mass, double radius, vec3 color, double brightness, vec3 velocity);
     Planet* addPlanet(float distance, double mass, double radius, vec3 color, double rotSpeed, float orbVel, float incRad);
     void addRing(Planet* parent, double distFromPlanet, double thickness, double inclination, vec3 color);
+    // count massless particles between inner and outer radius around a body; works for belts too.
+    // scatter is the random eccentricity and tilt, as a fraction of orbital speed.
+    size_t addParticleRing(size_t hostBody, double inner, double outer, double inclination, vec3 color, size_t count, double scatter);
     Satellite* addSatellite(Planet* parent, float distFromPlanet, double mass, double radius, vec3 color, double rotSpeed, float orbitalVel);
+    bool loadScenario(const char* path);
     void setSimulation();
-    void drawTrail(const deque<vec3>& points, vec3 color);
+    bool saveSnapshot(const char* path);
+    bool loadSnapshot(const char* path);
+    bool enableCheckpoints(const string& path, double intervalSeconds);
+    bool enableTrajectory(const string& path, uint32_t decimation);
+    bool enableDiagnostics(const string& path);
+    bool buildEphemeris(const string& path, double span, double segmentLength);
+    bool playEphemeris(const string& path);
+    bool isPlayingBack() const { return ephemeris != nullptr; }
+    void scrub(double seconds);
+    bool recordEvents(const string& path);
+    bool replayEvents(const string& path);
+    void drawTrails();
     void drawStar(Star& st);
     void drawPlanet(Planet& pt);
-    void step();
+    void drawPoints();
+    void drawParticles();
+    void step(double dt);
     bool run();
 
     // Static Callbacks
@@ -8,6 +8,8 @@
 #include <string>
 #include <fstream>
 #include <chrono>
+#include <cmath>
+#include <cstdint>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -15,6 +17,12 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "spacetime.h"
+#include "profiler.h"
+#include "gpuProfiler.h"
+#include "shaderCache.h"
+#include "shaderReloader.h"
+
 using Clock = std::chrono::high_resolution_clock;
 
 using namespace glm;
@@ -22,8 +30,6 @@ using namespace std;
 
 inline double lastPrintTime = 0.0;
 inline int    framesCount   = 0;
-inline double c = 299792458.0;
-inline double G = 6.67430e-11;
 inline bool Gravity = false;
 
 struct Camera {
@@ -63,17 +69,8 @@ struct BlackHole {
 };
 inline BlackHole SagA(vec3(0.0f, 0.0f, 0.0f), 8.54e36);
 
-struct ObjectData {
-    vec4 posRadius; // xyz = position, w = radius
-    vec4 color;     // rgb = color, a = unused
-    float  mass;
-    vec3 velocity; // Initial velocity
-};
-inline vector<ObjectData> objects = {
-    { vec4(4e11f, 0.0f, 0.0f, 4e10f),   vec4(1,1,0,1), 1.98892e30f, vec3(0.0f) },
-    { vec4(0.0f, 0.0f, 4e11f, 4e10f),   vec4(1,0,0,1), 1.98892e30f, vec3(0.0f) },
-    { vec4(0.0f, 0.0f, 0.0f, SagA.r_s), vec4(0,0,0,1), (float)SagA.mass, vec3(0.0f) }
-};
+// Filled from a scenario file at startup (resources/scenarios/blackHole.json by default)
+inline vector<ObjectData> objects;
 
 struct Engine {
     GLuint gridShaderID;
@@ -83,15 +80,31 @@ struct Engine {
     GLuint texture;
     GLuint shaderID;
     GLuint computeShaderID;
+    GLuint gridComputeShaderID;
+    ShaderCache shaderCache;
+    unique_ptr<ShaderReloader> shaderReloader; // release before glfwTerminate
 
     GLuint cameraUBO = 0;
     GLuint diskUBO = 0;
-    GLuint objectsUBO = 0;
+    GLuint objectsSSBO = 0;
+    size_t objectsCapacity = 0;   // objects the SSBO can hold without reallocating
+    size_t objectsUploaded = 0;   // object count last written to the SSBO header
+    size_t objectsDirtyBegin = 0; // [begin, end) range changed since the last upload
+    size_t objectsDirtyEnd = SIZE_MAX;
+    GLuint objectGridSSBO = 0;
+    GLsizeiptr objectGridCapacity = 0;
+    ObjectGrid objectGrid;
 
     GLuint gridVAO = 0;
     GLuint gridVBO = 0;
     GLuint gridEBO = 0;
     int gridIndexCount = 0;
+    int gridSize = 25;          // cells per side
+    float gridSpacing = 1e10f;  // meters per cell
+    int gridBuiltSize = -1;     // resolution the VBO/EBO were allocated for
+    uint64_t objectsVersion = 0, gridVersion = UINT64_MAX, objectGridVersion = UINT64_MAX;
+    bool gpuGrid = true;        // displace on the GPU; false uses displaceGrid() and uploads
+    vector<vec3> gridVertices;  // CPU fallback staging only
 
     int WIDTH = 800;  
     int HEIGHT = 600; 
@@ -101,6 +114,7 @@ struct Engine {
     float height = 7.5e10f; // Height of the viewport in meters
 
     Engine();
+    void buildGridMesh();
     void generateGrid(const vector<ObjectData>& objects);
     void drawGrid(const mat4& viewProj);
     void drawFullScreenQuad();
@@ -109,7 +123,9 @@ struct Engine {
     GLuint createComputeShader(const char* computeFile);
     void dispatchCompute(const Camera& cam);
     void uploadCameraUBO(const Camera& cam);
-    void uploadObjectsUBO(const vector<ObjectData>& objs);
+    void markObjectsDirty(size_t first, size_t count);
+    bool uploadObjects(const vector<ObjectData>& objs);
+    void uploadObjectGrid(const vector<ObjectData>& objs);
     void uploadDiskUBO();
     vector<GLuint> QuadVAO();
     void renderScene();
@@ -0,0 +1,59 @@
+/**
+ * Scenario files: the bodies a simulation starts from.
+ * * CSV (.csv) — header row naming the columns, one body per line, '#' starts a comment.
+ * * JSON (.json) — an array of objects (optionally under a top-level "bodies" key), parsed as a stream.
+ * * Binary (.snap) — a snapshot file, appended to the physics arrays in bulk.
+ * * Recognised keys: kind, name, parent, x, y, z, vx, vy, vz, mass, radius, r, g, b, brightness,
+ *   distance, orbitVel, inclination, phase, rotSpeed, thickness, count.
+ * * Rings with a count, and belts, become that many test particles between distance and
+ *   distance + thickness from their parent (a belt's default parent is the first star). Missing keys keep their defaults.
+ */
+
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+#include "physicsEngine.h"
+
+struct ScenarioBody {
+    std::string kind;   // star, planet, satellite, ring, belt, body (physics only) or object (ray engine)
+    std::string name;
+    std::string parent; // name of the body a satellite or ring belongs to
+    double x = 0.0, y = 0.0, z = 0.0;
+    double vx = 0.0, vy = 0.0, vz = 0.0;
+    double mass = 0.0, radius = 0.0;
+    double r = 1.0, g = 1.0, b = 1.0;
+    double brightness = 1.0;
+    // Orbit shorthand, as taken by Engine::addPlanet / addSatellite
+    double distance = 0.0, orbitVel = 0.0, inclination = 0.0, phase = 0.0;
+    double rotSpeed = 0.0;
+    double thickness = 0.0;
+    size_t count = 0;   // particles in a ring or belt; 0 keeps a ring as a flat mesh
+    bool hasState = false; // any of x..vz was given explicitly
+
+    void reset() { *this = ScenarioBody(); }
+};
+
+using ScenarioSink = std::function<void(const ScenarioBody&)>;
+
+bool isBinaryScenario(const char* path);
+// Upper bound on the number of records, cheap enough to size storage before parsing
+size_t countScenarioRecords(const char* path);
+// Streams CSV or JSON records to `sink`, one at a time
+bool readScenario(const char* path, const ScenarioSink& sink);
+// Appends every body of a binary scenario to `bodies`; parent indices are rebased
+bool appendBinaryScenario(const char* path, Bodies& bodies);
+
+// Headless counterpart of Engine::loadScenario: places stars, planets, satellites and bodies in
+// `bodies` the way the raster engine does, with no meshes (rings are skipped). `edit`, if
+// given, may change each CSV/JSON record before it is placed.
+bool loadScenarioBodies(const char* path, Bodies& bodies, const std::function<void(ScenarioBody&)>& edit = {});
+
+// Initial state of a record relative to its parent: explicit x..vz if given, otherwise the
+// addPlanet placement (distance tilted by inclination, orbitVel along +z) rotated by phase about y.
+void scenarioState(const ScenarioBody& body, double pos[3], double vel[3]);
+
+#endif
@@ -0,0 +1,58 @@
+/**
+ * class ShaderCache
+ * brief Builds GL programs at startup, in parallel where the driver allows, and caches their binaries.
+ * * request() returns a program name immediately. On a cache hit the binary is loaded with
+ *   glProgramBinary and no GLSL is compiled; on a miss every stage is compiled and linked but
+ *   nothing waits for the result, so all of an engine's programs build concurrently under
+ *   GL_KHR_parallel_shader_compile (or on the driver's own threads).
+ * * finish() waits for the outstanding programs, reports errors and stores the new binaries
+ *   as "<dir>/<hash>.bin". The hash covers every stage's source and the vendor, renderer and
+ *   version strings, so edited shaders or a driver update simply miss the cache.
+ * * note A binary the driver rejects is recompiled from source and overwritten.
+ */
+
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+struct ShaderStage {
+    GLenum type;        // GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_COMPUTE_SHADER
+    std::string source;
+    std::string label;  // file name, for error messages
+};
+
+class ShaderCache {
+public:
+    explicit ShaderCache(std::string dir = "build/shaderCache");
+
+    // Needs a current context. Compilation may still be in flight when this returns.
+    GLuint request(const std::vector<ShaderStage>& stages);
+    // Blocks until every requested program is linked. Returns false if any failed.
+    bool finish();
+
+private:
+    struct Pending {
+        GLuint program;
+        uint64_t hash;
+        std::vector<GLuint> shaders;
+        std::vector<std::string> labels;
+    };
+
+    std::string dir;
+    std::string driver;          // vendor/renderer/version, folded into every hash
+    bool initialized = false;
+    bool binariesSupported = false;
+    std::vector<Pending> pending;
+
+    void init();
+    std::string pathFor(uint64_t hash) const;
+    bool loadBinary(GLuint program, uint64_t hash);
+    void storeBinary(GLuint program, uint64_t hash);
+};
+
+#endif
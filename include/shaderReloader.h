@@ -0,0 +1,66 @@
+/**
+ * class ShaderReloader
+ * brief Rebuilds GL programs when their source files change, without restarting the app.
+ * * A background thread watches the shader directory with inotify. When a watched file is
+ *   saved, the thread recompiles the programs that use it in a hidden context sharing objects
+ *   with the main window, so the render loop never stalls on the compiler.
+ * * Finished programs are handed over under a lock and swapped in by apply(), which the
+ *   render loop calls between frames. A program that fails to compile or link is discarded
+ *   with its log and the previous one stays in use.
+ * * note Linux only (inotify); elsewhere watch() and apply() do nothing.
+ */
+
+#ifndef SHADER_RELOADER_H
+#define SHADER_RELOADER_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+struct ShaderFile {
+    GLenum type;      // GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_COMPUTE_SHADER
+    std::string path; // must live in the watched directory
+};
+
+class ShaderReloader {
+public:
+    // Call on the main thread with mainWindow's context current.
+    ShaderReloader(GLFWwindow* mainWindow, std::string directory);
+    ~ShaderReloader();
+
+    // Rebuilds *program from `files` whenever one of them changes. `program` must outlive the reloader.
+    void watch(GLuint* program, std::vector<ShaderFile> files);
+    // Swaps in every program rebuilt since the last call. Main thread, between frames.
+    void apply();
+
+private:
+    struct Watched {
+        GLuint* program;
+        std::vector<ShaderFile> files;
+    };
+    struct Rebuilt {
+        size_t index;
+        GLuint program;
+    };
+
+    std::string directory;
+    GLFWwindow* context = nullptr; // hidden, shares objects with the main window
+    int inotifyFd = -1;
+
+    std::mutex mtx;
+    std::vector<Watched> watched;
+    std::vector<Rebuilt> ready;
+
+    std::thread worker;
+    std::atomic<bool> stopping{ false };
+
+    void run();
+    void rebuild(size_t index);
+};
+
+#endif
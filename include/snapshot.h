@@ -0,0 +1,100 @@
+/**
+ * Binary snapshots of PhysicsEngine state.
+ * * Layout: a fixed SnapshotHeader followed by one 64-byte aligned array per field
+ *   (x, y, z, vx, vy, vz, mass, radius as double, parent as int32, the collision-merged flag as
+ *   uint8), so a mapped file can be read in place without parsing.
+ * * Files are written to "<path>.tmp" and renamed, so a crash never leaves a torn snapshot.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "physicsEngine.h"
+
+constexpr char     SNAPSHOT_MAGIC[8] = { 'C', 'G', 'L', 'S', 'N', 'A', 'P', '\0' };
+constexpr uint32_t SNAPSHOT_VERSION  = 2;
+
+enum SnapshotField : uint32_t {
+    SNAP_X, SNAP_Y, SNAP_Z, SNAP_VX, SNAP_VY, SNAP_VZ, SNAP_MASS, SNAP_RADIUS, SNAP_PARENT, SNAP_MERGED,
+    SNAP_FIELD_COUNT
+};
+
+struct SnapshotHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t bodyCount;
+    double   time;                       // simulated seconds
+    uint64_t offsets[SNAP_FIELD_COUNT];  // byte offset of each array from the start of the file
+    uint64_t fileSize;
+};
+
+// Read-only, zero-copy view of a snapshot file through mmap.
+struct SnapshotView {
+    const SnapshotHeader* header = nullptr;
+
+    SnapshotView() = default;
+    SnapshotView(const SnapshotView&) = delete;
+    SnapshotView& operator=(const SnapshotView&) = delete;
+    ~SnapshotView();
+
+    // Fails on a bad header, a truncated file, a parent index outside [-1, i) or a merged body without one
+    bool open(const char* path);
+    void close();
+
+    size_t size() const { return header ? (size_t)header->bodyCount : 0; }
+    double time() const { return header ? header->time : 0.0; }
+    const double* field(SnapshotField f) const;
+    const int32_t* parent() const;
+    const uint8_t* merged() const;
+
+private:
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+};
+
+bool saveSnapshot(const char* path, const Bodies& bodies, double time);
+bool saveSnapshot(const char* path, const PhysicsEngine& physics);
+// Replaces the engine's bodies and time with the snapshot contents
+bool loadSnapshot(const char* path, PhysicsEngine& physics);
+
+// Writes snapshots from a background thread. The simulation thread only pays for
+// copying the arrays into a staging buffer, and skips a checkpoint if the previous
+// one is still being written.
+class Checkpointer {
+public:
+    Checkpointer(std::string path, double intervalSeconds);
+    ~Checkpointer();
+
+    // Stages a copy of the state if at least intervalSeconds of wall time have passed
+    void maybeCheckpoint(const PhysicsEngine& physics);
+    // Stages a copy unconditionally (unless a write is in flight)
+    bool checkpoint(const PhysicsEngine& physics);
+
+private:
+    std::string path;
+    double interval;
+    double lastCheckpoint;
+
+    Bodies staging;
+    double stagingTime = 0.0;
+
+    std::thread worker;
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool pending = false;
+    bool stopping = false;
+    std::atomic<bool> writing{ false };
+
+    void run();
+};
+
+#endif
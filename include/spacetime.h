@@ -0,0 +1,83 @@
+/**
+ * Spacetime helpers shared by the ray engine and headless tools.
+ * Nothing in here touches OpenGL, so it can be linked without a context.
+ */
+
+#ifndef SPACETIME_H
+#define SPACETIME_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "physicsEngine.h"
+
+using namespace glm;
+
+inline double c = 299792458.0;
+inline double G = 6.67430e-11;
+
+// Matches the std430 `Object` struct in geodesic.comp and grid.comp byte for byte
+// (vec3 + float packs into one 16-byte slot), so the table uploads with a single memcpy.
+struct ObjectData {
+    vec4 posRadius; // xyz = position, w = radius
+    vec4 color;     // rgb = color, a = unused
+    vec3 velocity;  // Initial velocity
+    float  mass;
+};
+static_assert(sizeof(ObjectData) == 48, "ObjectData must match the std430 Object layout");
+
+// Uniform grid over the object spheres, built on the CPU and uploaded as an SSBO
+// so the geodesic march only tests the objects sharing the ray's current cell.
+struct ObjectGrid {
+    vec4  origin;  // xyz = min corner, w = cell size
+    ivec4 dims;    // xyz = cells per axis, w = total cells
+    vec4  bounds;  // xyz = bounding sphere center, w = radius
+    std::vector<uint32_t> cellStart;   // numCells + 1 offsets into cellObjects
+    std::vector<uint32_t> cellObjects; // object indices, grouped by cell
+
+    void build(const ObjectData* objs, size_t count);
+};
+
+// Reads the "object" records of a scenario file (see scenario.h) into `objs`
+bool loadObjects(const char* path, std::vector<ObjectData>& objs);
+
+// Copy object state into the physics arrays and back. Radius and color stay with the objects.
+void objectsToBodies(const std::vector<ObjectData>& objs, Bodies& bodies);
+void bodiesToObjects(const Bodies& bodies, std::vector<ObjectData>& objs);
+
+// Schwarzschild radius per kilogram (2G/c^2), rounded to float once so the CPU
+// and GPU grid paths scale masses identically.
+inline float schwarzschildPerKg() { return static_cast<float>(2.0 * G / (c * c)); }
+
+// CPU reference for grid.comp: writes (gridSize + 1)^2 vertices of the Flamm's
+// paraboloid sum over `objs`, row-major in z then x, centred on the origin.
+void displaceGrid(const ObjectData* objs, size_t count, int gridSize, float spacing, vec3* out);
+
+// Inputs of geodesic.comp, mirroring its Camera and Disk uniform blocks
+struct GeodesicCamera {
+    vec3 pos, right, up, forward;
+    float tanHalfFov;
+    float aspect;
+};
+
+struct GeodesicDisk {
+    float r1, r2;     // inner and outer radius of the accretion disk
+    float num;
+    float thickness;
+};
+
+// Schwarzschild radius and affine step hard-coded in geodesic.comp
+constexpr float GEODESIC_RS      = 1.269e10f;
+constexpr float GEODESIC_DLAMBDA = 1e7f;
+
+// CPU reference for geodesic.comp: marches one ray per pixel through the Schwarzschild
+// metric and writes width * height RGBA colors, row-major from the top. Uses the same
+// float math and step rule as the shader, so it doubles as a GPU-less benchmark.
+void traceGeodesics(const GeodesicCamera& cam, const GeodesicDisk& disk,
+                    const ObjectData* objs, const ObjectGrid& grid,
+                    int width, int height, int maxSteps, vec4* out);
+
+#endif
@@ -0,0 +1,55 @@
+/**
+ * struct TestParticles
+ * brief Massless particles for planetary rings and asteroid belts.
+ * * Particles feel the gravity of every massive body but exert none, so a step costs
+ *   particles × massive bodies rather than growing quadratically: 10⁶ ring particles around a
+ *   dozen bodies cost about as much as a 3000-body force pass.
+ * * Stored as structure-of-arrays like Bodies; the kernel runs OpenMP across particles and SIMD
+ *   across particles within a thread, with the few massive bodies in the inner loop.
+ * * PhysicsEngine::step() advances them kick-drift-kick alongside the bodies, whatever the
+ *   bodies' integrator; markBodiesChanged() makes the next step recompute their forces.
+ * * note Not part of snapshots, ephemerides or distributed runs.
+ */
+
+#ifndef TEST_PARTICLES_H
+#define TEST_PARTICLES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Bodies;
+
+// A disc of particles on near-circular orbits around one body
+struct ParticleDisc {
+    size_t host = 0;           // index of the body orbited
+    double inner = 0.0, outer = 0.0; // radii in metres, uniform in area between them
+    double inclination = 0.0;  // tilt of the disc plane about the x axis, as for Ring
+    double scatter = 1e-3;     // random eccentricity and inclination, as a fraction of orbital speed
+    size_t count = 0;
+    uint64_t seed = 1;
+};
+
+struct TestParticles {
+    std::vector<double> x, y, z;
+    std::vector<double> vx, vy, vz;
+    std::vector<double> ax, ay, az;
+    bool accelerationsValid = false;
+
+    size_t size() const { return x.size(); }
+    bool empty() const { return x.empty(); }
+    void reserve(size_t n);
+    void clear();
+    size_t add(double px, double py, double pz, double velX, double velY, double velZ);
+
+    // Accelerations from n point sources with gravitational parameters gm (G × mass); sources
+    // closer than minDistance exert no force, as in the body kernel
+    void accelerate(const double* sx, const double* sy, const double* sz, const double* gm, size_t n, double minDistance);
+    void kick(double dt);
+    void drift(double dt);
+};
+
+// Appends disc.count particles around bodies[disc.host]; returns the index of the first
+size_t addParticleDisc(TestParticles& particles, const Bodies& bodies, double gravConst, const ParticleDisc& disc);
+
+#endif
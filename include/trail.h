@@ -0,0 +1,57 @@
+/**
+ * Recent positions behind a body, drawn as a line strip.
+ * Kept in a ring buffer whose capacity is set once, when the body is added (setCapacity); after
+ * that, recording and staging points do not allocate.
+ * GL-free so the staging path can be benchmarked without a context.
+ */
+
+#ifndef TRAIL_H
+#define TRAIL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+struct Trail {
+    explicit Trail(size_t capacity = 4096) : ring(std::max<size_t>(capacity, 1)) {}
+
+    size_t size() const { return count; }
+    size_t capacity() const { return ring.size(); }
+    void clear() { head = count = 0; }
+
+    // Reallocates the ring and drops any recorded points
+    void setCapacity(size_t capacity) {
+        ring.assign(std::max<size_t>(capacity, 1), glm::vec3(0.0f));
+        clear();
+    }
+
+    // Appends p, then drops the oldest points beyond maxPoints (and beyond capacity())
+    void push(const glm::vec3& p, size_t maxPoints = SIZE_MAX) {
+        ring[(head + count) % ring.size()] = p;
+        if (count < ring.size()) ++count;
+        else head = (head + 1) % ring.size();
+        size_t keep = std::max<size_t>(std::min(maxPoints, ring.size()), 1);
+        if (count > keep) {
+            head = (head + count - keep) % ring.size();
+            count = keep;
+        }
+    }
+
+    // Copies the points, oldest first, into size() contiguous elements for upload
+    void stage(glm::vec3* out) const {
+        size_t first = std::min(count, ring.size() - head);
+        memcpy(out, ring.data() + head, first * sizeof(glm::vec3));
+        memcpy(out + first, ring.data(), (count - first) * sizeof(glm::vec3));
+    }
+
+private:
+    std::vector<glm::vec3> ring;
+    size_t head = 0; // oldest point
+    size_t count = 0;
+};
+
+#endif
@@ -0,0 +1,146 @@
+/**
+ * Streaming trajectory output for offline analysis.
+ * * The simulation thread hands frames to a dedicated I/O thread through lock-free
+ *   single-producer/single-consumer queues over a fixed pool of frame buffers. If the
+ *   pool is exhausted the frame is dropped and counted; push() never blocks or allocates. A chunk
+ *   that fails to compress is left out whole and its frames counted as dropped.
+ * * File layout: TrajectoryHeader, then chunks. A chunk is a TrajectoryChunkHeader, the
+ *   frame times (raw double), and one block per column (x, y, z, vx, vy, vz). Each block is
+ *   that column for every frame in the chunk, frame-major, byte-shuffled and zlib-compressed.
+ */
+
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "physicsEngine.h"
+
+constexpr char     TRAJECTORY_MAGIC[8] = { 'C', 'G', 'L', 'T', 'R', 'A', 'J', '\0' };
+constexpr uint32_t TRAJECTORY_VERSION  = 1;
+constexpr uint32_t TRAJECTORY_COLUMNS  = 6;
+
+struct TrajectoryHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t columnCount;
+    uint64_t bodyCount;
+    uint32_t decimation;     // one frame written per `decimation` pushes
+    uint32_t framesPerChunk;
+};
+
+struct TrajectoryChunkHeader {
+    uint32_t frameCount;
+    uint32_t columnCount;
+};
+
+// Wait-free ring for one producer and one consumer; capacity is rounded up to a power of two.
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity = 0) { reset(capacity); }
+
+    void reset(size_t capacity) {
+        size_t n = 1;
+        while (n < capacity) n <<= 1;
+        slots.assign(n, T());
+        mask = n - 1;
+        head.store(0);
+        tail.store(0);
+    }
+
+    bool push(const T& value) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) > mask) return false;
+        slots[t & mask] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& out) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false;
+        out = slots[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::vector<T> slots;
+    size_t mask = 0;
+    alignas(64) std::atomic<size_t> head{ 0 };
+    alignas(64) std::atomic<size_t> tail{ 0 };
+};
+
+class TrajectoryWriter {
+public:
+    // memoryBudget bounds the frame pool plus one chunk of staging, in bytes
+    TrajectoryWriter(const std::string& path, size_t bodyCount, uint32_t decimation = 1,
+                     size_t memoryBudget = size_t(256) << 20);
+    ~TrajectoryWriter();
+
+    bool isOpen() const { return opened; }
+    // Called from the simulation thread after each step. Returns false if the frame was dropped, or
+    // if the body count no longer matches the file, which stops the recording (reported once).
+    bool push(const Bodies& bodies, double time);
+
+    uint64_t framesWritten() const { return written.load(std::memory_order_relaxed); }
+    uint64_t framesDropped() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    struct Frame {
+        double time;
+        std::vector<double> columns[TRAJECTORY_COLUMNS];
+    };
+
+    std::ofstream out;
+    bool opened = false;
+    size_t bodyCount;
+    uint32_t decimation;
+    uint32_t framesPerChunk;
+    uint64_t pushes = 0;
+    bool resized = false; // the body count changed; nothing more is recorded
+
+    std::vector<Frame> pool;
+    SpscQueue<Frame*> freeFrames;
+    SpscQueue<Frame*> filledFrames;
+
+    // I/O thread state
+    std::vector<double> chunkTimes;
+    std::vector<double> chunkColumns[TRAJECTORY_COLUMNS];
+    std::vector<unsigned char> shuffled[TRAJECTORY_COLUMNS];
+    std::vector<unsigned char> compressed[TRAJECTORY_COLUMNS];
+    uint32_t chunkFrames = 0;
+    uint64_t failedChunks = 0;
+
+    std::thread worker;
+    std::atomic<bool> stopping{ false };
+    std::atomic<uint64_t> written{ 0 };
+    std::atomic<uint64_t> dropped{ 0 };
+
+    void run();
+    void writeChunk();
+};
+
+// Sequential reader for files produced by TrajectoryWriter.
+class TrajectoryReader {
+public:
+    bool open(const std::string& path);
+    const TrajectoryHeader& header() const { return hdr; }
+
+    // Decodes the next chunk. columns[c] holds frameCount * bodyCount values, frame-major.
+    bool nextChunk(std::vector<double>& times, std::vector<double> (&columns)[TRAJECTORY_COLUMNS]);
+
+private:
+    std::ifstream in;
+    TrajectoryHeader hdr = {};
+    std::vector<unsigned char> packed, shuffled;
+};
+
+#endif
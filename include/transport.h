@@ -0,0 +1,59 @@
+/**
+ * Message transport between the processes of a distributed run.
+ * * Transport is the pluggable interface: point-to-point exchange() plus allToAll()/allGather()
+ *   built on it in a fixed pairwise schedule, so no backend needs collectives of its own.
+ * * SocketTransport: a fully connected mesh of socketpair()s for ranks on one machine, created
+ *   before fork(); the stand-in used for tests and laptop runs.
+ * * MpiTransport: the same interface over MPI, compiled only with -DCOSMOS_MPI (build with mpicxx).
+ * * note Messages are opaque byte blobs; callers agree on their layout and on the call order.
+ */
+
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <memory>
+#include <vector>
+
+class Transport {
+public:
+    virtual ~Transport() = default;
+    virtual int rank() const = 0;
+    virtual int size() const = 0;
+    // Sends `out` to rank `to` while receiving `in` from rank `from`; never deadlocks on large messages
+    virtual bool exchange(int to, const std::vector<char>& out, int from, std::vector<char>& in) = 0;
+
+    // outgoing[q] goes to rank q; incoming[q] is what rank q sent here (incoming[rank()] = outgoing[rank()])
+    bool allToAll(const std::vector<std::vector<char>>& outgoing, std::vector<std::vector<char>>& incoming);
+    // Every rank ends up with every rank's blob, in rank order
+    bool allGather(const std::vector<char>& mine, std::vector<std::vector<char>>& all);
+};
+
+class SocketTransport : public Transport {
+public:
+    // n connected endpoints. After fork(), each process keeps its own and destroys the rest.
+    static std::vector<std::unique_ptr<SocketTransport>> createLocal(int n);
+    ~SocketTransport() override;
+
+    int rank() const override { return me; }
+    int size() const override { return (int)peers.size(); }
+    bool exchange(int to, const std::vector<char>& out, int from, std::vector<char>& in) override;
+
+private:
+    int me = 0;
+    std::vector<int> peers; // socket to each rank, -1 for self
+};
+
+#ifdef COSMOS_MPI
+class MpiTransport : public Transport {
+public:
+    MpiTransport(); // MPI_Init must already have run
+    int rank() const override { return me; }
+    int size() const override { return count; }
+    bool exchange(int to, const std::vector<char>& out, int from, std::vector<char>& in) override;
+
+private:
+    int me = 0, count = 1;
+};
+#endif
+
+#endif
@@ -0,0 +1,42 @@
+/**
+ * Lock-free triple buffer for handing state from one producer thread to one consumer thread.
+ * * The producer fills back(), then publish() swaps it with the shared middle slot.
+ * * The consumer calls update() to take the middle slot if it holds something newer, then
+ *   reads front() for as long as it likes. Neither side ever waits on the other; the
+ *   consumer simply skips intermediate states when the producer is faster.
+ */
+
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+template <typename T>
+class TripleBuffer {
+public:
+    // Producer side
+    T& back() { return slots[backIndex]; }
+    void publish() {
+        backIndex = middle.exchange(uint8_t(backIndex | FRESH), std::memory_order_acq_rel) & INDEX;
+    }
+
+    // Consumer side. Returns true if front() changed.
+    bool update() {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH)) return false;
+        frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+    const T& front() const { return slots[frontIndex]; }
+
+private:
+    static constexpr uint8_t INDEX = 3;
+    static constexpr uint8_t FRESH = 4;
+
+    T slots[3];
+    uint8_t frontIndex = 0;
+    uint8_t backIndex = 1;
+    std::atomic<uint8_t> middle{ 2 };
+};
+
+#endif
@@ -0,0 +1,11 @@
+#version 460 core
+out vec4 FragColor;
+
+in vec2 Corner;
+in vec4 Color;
+
+void main() {
+    float d = dot(Corner, Corner);
+    if (d > 1.0) discard;
+    FragColor = vec4(Color.rgb, Color.a * (1.0 - d));
+}
@@ -0,0 +1,23 @@
+#version 460 core
+layout (location = 0) in vec2 aCorner; // quad corner in [-1, 1]
+layout (location = 1) in vec3 aCenter; // per instance
+layout (location = 2) in vec4 aColor;  // per instance
+
+layout (std140, binding=0) uniform WindowData {
+    mat4 projection;
+    mat4 view;
+};
+
+uniform vec2 viewport;  // framebuffer size in pixels
+uniform float pointSize; // sprite diameter in pixels, whatever the distance
+
+out vec2 Corner;
+out vec4 Color;
+
+void main() {
+    vec4 clip = projection * view * vec4(aCenter, 1.0);
+    clip.xy += aCorner * pointSize / viewport * clip.w;
+    gl_Position = clip;
+    Corner = aCorner;
+    Color = aColor;
+}
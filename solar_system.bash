@@ -1,3 +1,3 @@
-g++ src/solarSystem.cpp src/rasterEngine.cpp -lglad -ldl -lGL -lglfw -Iinclude -o build/solarSystem
+g++ src/solarSystem.cpp src/rasterEngine.cpp src/physicsEngine.cpp src/testParticles.cpp src/mortonOrder.cpp src/collisions.cpp src/kepler.cpp src/snapshot.cpp src/scenario.cpp src/trajectory.cpp src/diagnostics.cpp src/ephemeris.cpp src/eventLog.cpp src/shaderCache.cpp src/shaderReloader.cpp -fopenmp -O2 -pthread -lglad -ldl -lGL -lglfw -lz -Iinclude -o build/solarSystem
 
 ./build/solarSystem
\ No newline at end of file
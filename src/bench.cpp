@@ -0,0 +1,390 @@
+// Benchmarks for the GL-free kernels: N-body forces and integrators, conservation diagnostics, test particles,
+// collision detection, Morton reordering, trail staging, spacetime grid displacement and the CPU geodesic tracer.
+// Needs no GPU or window.
+//
+//   ./bench.bash                                  # everything, JSON in build/bench.json
+//   ./bench.bash --benchmark_filter=ForceKernel   # one family
+//   ./bench.bash --benchmark_filter=-Large        # everything but the hour-long N = 10^5, 10^6 force passes (CI)
+//
+// The "allocs" counter is heap allocations per iteration after a warm-up iteration; 0 means the
+// steady state never touches the allocator. "misses" is hardware cache misses per iteration, summed
+// over the OpenMP threads; it is left out where perf events are unavailable (virtual machines
+// without a PMU, perf_event_paranoid above 2).
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <omp.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "collisions.h"
+#include "frameArena.h"
+#include "mortonOrder.h"
+#include "physicsEngine.h"
+#include "pool.h"
+#include "spacetime.h"
+#include "trail.h"
+
+using namespace std;
+
+// Every heap allocation in the process goes through here: plain, array and over-aligned forms, throwing or not
+static atomic<uint64_t> heapAllocations{ 0 };
+
+static void* countedAlloc(size_t size, size_t align) {
+    heapAllocations.fetch_add(1, memory_order_relaxed);
+    size = size ? size : 1;
+    if (align <= alignof(max_align_t)) return malloc(size);
+    return aligned_alloc(align, (size + align - 1) / align * align);
+}
+
+#pragma GCC diagnostic push
+// GCC flags free() on memory from operator new once these inline; every new here allocates with malloc or aligned_alloc
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void* operator new(size_t size) {
+    if (void* p = countedAlloc(size, 0)) return p;
+    throw bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, align_val_t align) {
+    if (void* p = countedAlloc(size, (size_t)align)) return p;
+    throw bad_alloc();
+}
+void* operator new[](size_t size, align_val_t align) { return operator new(size, align); }
+void* operator new(size_t size, const nothrow_t&) noexcept { return countedAlloc(size, 0); }
+void* operator new[](size_t size, const nothrow_t&) noexcept { return countedAlloc(size, 0); }
+void* operator new(size_t size, align_val_t align, const nothrow_t&) noexcept { return countedAlloc(size, (size_t)align); }
+void* operator new[](size_t size, align_val_t align, const nothrow_t&) noexcept { return countedAlloc(size, (size_t)align); }
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+void operator delete(void* p, align_val_t) noexcept { free(p); }
+void operator delete[](void* p, align_val_t) noexcept { free(p); }
+void operator delete(void* p, size_t, align_val_t) noexcept { free(p); }
+void operator delete[](void* p, size_t, align_val_t) noexcept { free(p); }
+void operator delete(void* p, const nothrow_t&) noexcept { free(p); }
+void operator delete[](void* p, const nothrow_t&) noexcept { free(p); }
+void operator delete(void* p, align_val_t, const nothrow_t&) noexcept { free(p); }
+void operator delete[](void* p, align_val_t, const nothrow_t&) noexcept { free(p); }
+#pragma GCC diagnostic pop
+
+// Counts allocations from construction to report(), averaged over the benchmark's iterations
+class AllocationCounter {
+public:
+    AllocationCounter() : start(heapAllocations.load(memory_order_relaxed)) {}
+    void report(benchmark::State& state) const {
+        double n = (double)(heapAllocations.load(memory_order_relaxed) - start);
+        state.counters["allocs"] = benchmark::Counter(n, benchmark::Counter::kAvgIterations);
+    }
+
+private:
+    uint64_t start;
+};
+
+// Counts last-level cache misses from construction to report(), averaged over the benchmark's
+// iterations. Each OpenMP thread opens a counter for itself, since the pool threads already exist.
+class CacheMissCounter {
+public:
+    CacheMissCounter() : fds(omp_get_max_threads(), -1) {
+        #pragma omp parallel
+        {
+            perf_event_attr attr = {};
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fds[omp_get_thread_num()] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        }
+    }
+    ~CacheMissCounter() {
+        for (int fd : fds) {
+            if (fd >= 0) close(fd);
+        }
+    }
+    void report(benchmark::State& state) const {
+        uint64_t total = 0;
+        for (int fd : fds) {
+            uint64_t count = 0;
+            if (fd < 0 || read(fd, &count, sizeof(count)) != sizeof(count)) return;
+            total += count;
+        }
+        state.counters["misses"] = benchmark::Counter((double)total, benchmark::Counter::kAvgIterations);
+    }
+
+private:
+    vector<int> fds;
+};
+
+// Fixed-seed disc of bodies around a central mass, so runs are comparable between builds
+static void makeDisc(PhysicsEngine& physics, size_t n) {
+    mt19937_64 rng(42);
+    uniform_real_distribution<double> radius(5e10, 5e12), angle(0.0, 2.0 * M_PI), height(-1e9, 1e9);
+
+    physics.bodies.clear();
+    physics.bodies.reserve(n);
+    physics.bodies.add(0, 0, 0, 0, 0, 0, 1.989e30, 6.96e8);
+    for (size_t i = 1; i < n; ++i) {
+        double r = radius(rng), a = angle(rng);
+        double v = sqrt(physics.gravConst * 1.989e30 / r);
+        physics.bodies.add(r * cos(a), height(rng), r * sin(a), -v * sin(a), 0, v * cos(a), 1e22, 1e6);
+    }
+    physics.minDistance = 1e5;
+    physics.time = 0.0;
+    physics.markBodiesChanged();
+}
+
+static void BM_ForceKernel(benchmark::State& state) {
+    PhysicsEngine physics;
+    makeDisc(physics, (size_t)state.range(0));
+    physics.computeAccelerations();
+    CacheMissCounter misses;
+    AllocationCounter allocs;
+    for (auto _ : state) {
+        physics.computeAccelerations();
+        benchmark::DoNotOptimize(physics.bodies.ax.data());
+        benchmark::ClobberMemory();
+    }
+    allocs.report(state);
+    misses.report(state);
+    state.SetItemsProcessed(state.iterations() * state.range(0) * state.range(0)); // pair interactions
+}
+BENCHMARK(BM_ForceKernel)->RangeMultiplier(10)->Range(10, 10000)->Unit(benchmark::kMicrosecond);
+
+// 10^10 and 10^12 pair interactions per pass: one timed pass each and no warm-up, which would
+// double the cost (so no allocs counter either). Minutes to hours on one core; CI filters it out.
+static void BM_ForceKernelLarge(benchmark::State& state) {
+    PhysicsEngine physics;
+    makeDisc(physics, (size_t)state.range(0));
+    CacheMissCounter misses;
+    for (auto _ : state) {
+        physics.computeAccelerations();
+        benchmark::DoNotOptimize(physics.bodies.ax.data());
+        benchmark::ClobberMemory();
+    }
+    misses.report(state);
+    state.SetItemsProcessed(state.iterations() * state.range(0) * state.range(0));
+}
+BENCHMARK(BM_ForceKernelLarge)->Arg(100000)->Arg(1000000)->Iterations(1)->Unit(benchmark::kMillisecond);
+
+static void BM_SoftenedForces(benchmark::State& state) {
+    static const char* names[] = { "None", "Plummer", "Spline" };
+    PhysicsEngine physics;
+    makeDisc(physics, (size_t)state.range(1));
+    physics.softening = (Softening)state.range(0);
+    physics.softeningLength = 1e9;
+    for (auto _ : state) {
+        physics.computeAccelerations();
+        benchmark::DoNotOptimize(physics.bodies.ax.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetLabel(names[state.range(0)]);
+    state.SetItemsProcessed(state.iterations() * state.range(1) * state.range(1));
+}
+BENCHMARK(BM_SoftenedForces)
+    ->ArgsProduct({ { (int)Softening::None, (int)Softening::Plummer, (int)Softening::Spline }, { 1000, 10000 } })
+    ->Unit(benchmark::kMicrosecond);
+
+// Cost of accumulating potential energy and momentum alongside the forces
+static void BM_Diagnostics(benchmark::State& state) {
+    PhysicsEngine physics;
+    makeDisc(physics, (size_t)state.range(1));
+    physics.diagnostics = state.range(0) != 0;
+    physics.computeAccelerations();
+    AllocationCounter allocs;
+    for (auto _ : state) {
+        physics.computeAccelerations();
+        benchmark::DoNotOptimize(physics.metrics.potential);
+        benchmark::ClobberMemory();
+    }
+    allocs.report(state);
+    state.SetLabel(physics.diagnostics ? "on" : "off");
+    state.SetItemsProcessed(state.iterations() * state.range(1) * state.range(1));
+}
+BENCHMARK(BM_Diagnostics)->ArgsProduct({ { 0, 1 }, { 1000, 10000 } })->Unit(benchmark::kMicrosecond);
+
+static void BM_Step(benchmark::State& state) {
+    static const char* names[] = { "SemiImplicitEuler", "Leapfrog", "WisdomHolman" };
+    PhysicsEngine physics;
+    physics.integrator = (Integrator)state.range(0);
+    makeDisc(physics, (size_t)state.range(1));
+    physics.step(3600.0);
+    AllocationCounter allocs;
+    for (auto _ : state) {
+        physics.step(3600.0);
+        benchmark::ClobberMemory();
+    }
+    allocs.report(state);
+    state.SetLabel(names[state.range(0)]);
+    state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+BENCHMARK(BM_Step)
+    ->ArgsProduct({ { (int)Integrator::SemiImplicitEuler, (int)Integrator::Leapfrog, (int)Integrator::WisdomHolman }, { 10, 100, 1000, 10000 } })
+    ->Unit(benchmark::kMicrosecond);
+
+static void BM_TestParticles(benchmark::State& state) {
+    PhysicsEngine physics;
+    makeDisc(physics, 16);
+    ParticleDisc belt;
+    belt.inner = 3e11;
+    belt.outer = 5e11;
+    belt.count = (size_t)state.range(0);
+    addParticleDisc(physics.particles, physics.bodies, physics.gravConst, belt);
+    physics.step(3600.0);
+    AllocationCounter allocs;
+    for (auto _ : state) {
+        physics.step(3600.0);
+        benchmark::ClobberMemory();
+    }
+    allocs.report(state);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TestParticles)->RangeMultiplier(10)->Range(10000, 1000000)->Unit(benchmark::kMillisecond);
+
+// Second argument 1: bodies Morton-sorted first, so sweep neighbours are memory neighbours
+static void BM_CollisionFind(benchmark::State& state) {
+    PhysicsEngine physics;
+    makeDisc(physics, (size_t)state.range(0));
+    if (state.range(1)) physics.sortBodies();
+    Bodies& b = physics.bodies;
+    // Swept test over one hour of motion, the step size used above
+    vector<double> x0(b.size()), y0(b.size()), z0(b.size());
+    for (size_t i = 0; i < b.size(); ++i) {
+        x0[i] = b.x[i] - b.vx[i] * 3600.0;
+        y0[i] = b.y[i] - b.vy[i] * 3600.0;
+        z0[i] = b.z[i] - b.vz[i] * 3600.0;
+    }
+    CollisionDetector detector;
+    vector<Collision> found;
+    detector.find(b, x0.data(), y0.data(), z0.data(), found);
+    CacheMissCounter misses;
+    AllocationCounter allocs;
+    for (auto _ : state) {
+        detector.find(b, x0.data(), y0.data(), z0.data(), found);
+        benchmark::DoNotOptimize(found.data());
+    }
+    allocs.report(state);
+    misses.report(state);
+    state.SetLabel(state.range(1) ? "morton" : "insertion");
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CollisionFind)->ArgsProduct({ { 100, 1000, 10000, 100000, 1000000 }, { 0, 1 } })->Unit(benchmark::kMicrosecond);
+
+// Cost of one reorder: keys, radix sort and the permutation of every body array
+static void BM_MortonSort(benchmark::State& state) {
+    PhysicsEngine physics;
+    makeDisc(physics, (size_t)state.range(0));
+    for (auto _ : state) {
+        physics.sortBodies();
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MortonSort)->RangeMultiplier(10)->Range(1000, 1000000)->Unit(benchmark::kMicrosecond);
+
+static void BM_TrailStage(benchmark::State& state) {
+    Trail trail((size_t)state.range(0));
+    for (int64_t i = 0; i < state.range(0); ++i) trail.push(vec3((float)i, 0.0f, (float)-i));
+    vector<vec3> staging(trail.size());
+    AllocationCounter allocs;
+    for (auto _ : state) {
+        // Steady state of a recording trail: one point in, the oldest out, then restage
+        trail.push(vec3(1.0f));
+        trail.stage(staging.data());
+        benchmark::DoNotOptimize(staging.data());
+    }
+    allocs.report(state);
+    state.SetBytesProcessed(state.iterations() * state.range(0) * sizeof(vec3));
+}
+BENCHMARK(BM_TrailStage)->RangeMultiplier(10)->Range(100, 100000);
+
+// The renderer's per-frame pattern without GL: pooled objects each record a trail point, then
+// every trail is staged into one arena-backed upload buffer
+static void BM_FrameScratch(benchmark::State& state) {
+    Pool<Trail> trails;
+    for (int64_t k = 0; k < state.range(0); ++k) {
+        Trail& t = trails[trails.create(1000)];
+        for (int i = 0; i < 1000; ++i) t.push(vec3((float)i, (float)k, 0.0f));
+    }
+    FrameArena arena(1 << 10); // deliberately small: the first frames grow it
+    auto frame = [&]() {
+        arena.reset();
+        size_t total = 0;
+        for (Trail& t : trails) {
+            t.push(vec3(1.0f));
+            total += t.size();
+        }
+        vec3* staged = arena.allocate<vec3>(total);
+        for (Trail& t : trails) {
+            t.stage(staged);
+            staged += t.size();
+        }
+        benchmark::DoNotOptimize(staged);
+    };
+    frame();
+    frame();
+    AllocationCounter allocs;
+    for (auto _ : state) frame();
+    allocs.report(state);
+    state.counters["arenaBytes"] = (double)arena.capacity();
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_FrameScratch)->Arg(10)->Arg(100)->Arg(1000);
+
+static bool loadBlackHoleScene(benchmark::State& state, vector<ObjectData>& objs) {
+    if (loadObjects("resources/scenarios/blackHole.json", objs) && !objs.empty()) return true;
+    state.SkipWithError("resources/scenarios/blackHole.json not found; run from the repository root");
+    return false;
+}
+
+static void BM_DisplaceGrid(benchmark::State& state) {
+    vector<ObjectData> objs;
+    if (!loadBlackHoleScene(state, objs)) return;
+    int gridSize = (int)state.range(0);
+    vector<vec3> vertices(size_t(gridSize + 1) * (gridSize + 1));
+    for (auto _ : state) {
+        displaceGrid(objs.data(), objs.size(), gridSize, 1e10f, vertices.data());
+        benchmark::DoNotOptimize(vertices.data());
+    }
+    state.SetItemsProcessed(state.iterations() * vertices.size());
+}
+BENCHMARK(BM_DisplaceGrid)->Arg(25)->Arg(100)->Arg(400)->Unit(benchmark::kMicrosecond);
+
+static void BM_GeodesicTrace(benchmark::State& state) {
+    vector<ObjectData> objs;
+    if (!loadBlackHoleScene(state, objs)) return;
+    ObjectGrid grid;
+    grid.build(objs.data(), objs.size());
+
+    // The ray engine's default orbit camera, tilted slightly so rays cross the disk
+    float radius = 6.34194e10f, elevation = float(M_PI) / 2.0f - 0.15f;
+    GeodesicCamera cam;
+    cam.pos = vec3(radius * sin(elevation), radius * cos(elevation), 0.0f);
+    cam.forward = normalize(-cam.pos);
+    cam.right = normalize(cross(cam.forward, vec3(0.0f, 1.0f, 0.0f)));
+    cam.up = cross(cam.right, cam.forward);
+    cam.tanHalfFov = tan(radians(30.0f));
+    cam.aspect = 800.0f / 600.0f;
+    GeodesicDisk disk = { GEODESIC_RS * 2.2f, GEODESIC_RS * 5.2f, 2.0f, 1e9f };
+
+    int width = (int)state.range(0), height = width * 3 / 4;
+    vector<vec4> image(size_t(width) * height);
+    for (auto _ : state) {
+        traceGeodesics(cam, disk, objs.data(), grid, width, height, 60000, image.data());
+        benchmark::DoNotOptimize(image.data());
+    }
+    state.SetItemsProcessed(state.iterations() * image.size()); // rays
+}
+BENCHMARK(BM_GeodesicTrace)->Arg(50)->Arg(100)->Arg(200)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
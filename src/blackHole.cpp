@@ -1,7 +1,66 @@
 #include "rayEngine.h"
+#include "eventLog.h"
 
-int main() {
+#include <cstdio>
+
+// Re-runs a recorded session without rendering: the logged Gravity toggles drive the physics,
+// and every logged state hash is checked
+static bool replaySession(const char* path, PhysicsEngine& physics) {
+    EventReplay log;
+    if (!log.open(path) || !log.applySettings(physics)) return false;
+    if (!log.verify(0, physics.stateHash())) {
+        cerr << "Initial state differs from the recording; load the same scenario" << endl;
+        return false;
+    }
+
+    bool gravity = false;
+    auto start = Clock::now();
+    for (uint64_t frame = 0; frame < log.lastStep(); ++frame) {
+        log.eventsAt(frame, [&](const SimEvent& e) {
+            if (e.name == "gravity") gravity = e.value != 0.0;
+        });
+        if (gravity) physics.step(log.dt);
+        log.verify(frame + 1, physics.stateHash());
+    }
+    double wall = chrono::duration<double>(Clock::now() - start).count();
+
+    cout << "Replayed " << log.lastStep() << " frames in " << wall << " s: "
+         << (log.mismatches() == 0 ? "bit-exact" : to_string(log.mismatches()) + " hash mismatches") << endl;
+    return log.mismatches() == 0;
+}
+
+int main(int argc, char** argv) {
     setupCameraCallbacks(engine.window);
+
+    PhysicsEngine physics;
+
+    // -v streams per-body velocities through a buffered log instead of flushing every line;
+    // --scenario <file> replaces the default set of lensed objects;
+    // --record <log> logs Gravity toggles per frame with state hashes, --replay <log> re-runs one headless
+    LogChannel velocityLog(cout);
+    string scenarioPath = "resources/scenarios/blackHole.json", recordPath, replayPath;
+    for (int i = 1; i < argc; ++i) {
+        string opt = argv[i];
+        if (opt == "-v") physics.log = &velocityLog;
+        else if (opt == "--scenario" && i + 1 < argc) scenarioPath = argv[++i];
+        else if (opt == "--record" && i + 1 < argc) recordPath = argv[++i];
+        else if (opt == "--replay" && i + 1 < argc) replayPath = argv[++i];
+    }
+    if (!loadObjects(scenarioPath.c_str(), objects)) return 1;
+    objectsToBodies(objects, physics.bodies);
+    if (!replayPath.empty()) return replaySession(replayPath.c_str(), physics) ? 0 : 1;
+
+    // Physics advances one fixed 1 s step per frame with Gravity on, so a session is fully
+    // described by the frames at which Gravity changed
+    EventRecorder recorder;
+    bool recording = !recordPath.empty();
+    if (recording) {
+        if (!recorder.open(recordPath.c_str(), 1.0)) return 1;
+        recorder.settings(physics);
+        recorder.hash(0, physics.stateHash());
+    }
+    uint64_t frame = 0;
+    bool gravityWas = false;
     vector<unsigned char> pixels(engine.WIDTH * engine.HEIGHT * 3);
 
     auto t0 = Clock::now();
@@ -10,6 +69,7 @@ int main() {
     double lastTime = glfwGetTime();
     int   renderW  = 800, renderH = 600, numSteps = 80000;
     while (!glfwWindowShouldClose(engine.window)) {
+        engine.shaderReloader->apply();
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);  // optional, but good practice
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -17,34 +77,20 @@ int main() {
         double dt    = now - lastTime;   // seconds since last frame
         lastTime     = now;
 
-        // Gravity
-        for (auto& obj : objects) {
-            for (auto& obj2 : objects) {
-                if (&obj == &obj2) continue; // skip self-interaction
-                 float dx  = obj2.posRadius.x - obj.posRadius.x;
-                 float dy = obj2.posRadius.y - obj.posRadius.y;
-                 float dz = obj2.posRadius.z - obj.posRadius.z;
-                 float distance = sqrt(dx * dx + dy * dy + dz * dz);
-                 if (distance > 0) {
-                        vector<double> direction = {dx / distance, dy / distance, dz / distance};
-                        //distance *= 1000;
-                        double Gforce = (G * obj.mass * obj2.mass) / (distance * distance);
-
-                        double acc1 = Gforce / obj.mass;
-                        std::vector<double> acc = {direction[0] * acc1, direction[1] * acc1, direction[2] * acc1};
-                        if (Gravity) {
-                            obj.velocity.x += acc[0];
-                            obj.velocity.y += acc[1];
-                            obj.velocity.z += acc[2];
-
-                            obj.posRadius.x += obj.velocity.x;
-                            obj.posRadius.y += obj.velocity.y;
-                            obj.posRadius.z += obj.velocity.z;
-                            cout << "velocity: " <<obj.velocity.x<<", " <<obj.velocity.y<<", " <<obj.velocity.z<<endl;
-                        }
-                    }
-            }
+        // Input callbacks run inside glfwPollEvents; sample Gravity once so it applies to whole frames
+        bool gravity = Gravity;
+        if (recording && gravity != gravityWas) recorder.event(frame, "gravity", gravity ? 1.0 : 0.0);
+        gravityWas = gravity;
+
+        // Gravity: one force pass over all pairs, then the update, in frame-sized steps
+        if (gravity) {
+            PROFILE_ZONE("step");
+            physics.step(1.0);
+            bodiesToObjects(physics.bodies, objects);
+            engine.markObjectsDirty(0, objects.size());
         }
+        ++frame;
+        if (recording && frame % 100 == 0) recorder.hash(frame, physics.stateHash());
 
 
 
@@ -65,8 +111,26 @@ int main() {
         // 6) present to screen
         glfwSwapBuffers(engine.window);
         glfwPollEvents();
+        PROFILE_GPU_COLLECT();
+
+        // Once a second: frame rate, plus the per-zone breakdown when built with -DCOSMOS_PROFILE
+        framesCount++;
+        double wallNow = chrono::duration<double>(Clock::now().time_since_epoch()).count();
+        if (wallNow - lastPrintTime >= 1.0) {
+            char title[512];
+            int len = snprintf(title, sizeof(title), "Black Hole | %d fps", int(framesCount / (wallNow - lastPrintTime)));
+            string zones = PROFILE_SUMMARY(framesCount);
+            if (!zones.empty()) snprintf(title + len, sizeof(title) - len, " | %s", zones.c_str());
+            glfwSetWindowTitle(engine.window, title);
+            framesCount = 0;
+            lastPrintTime = wallNow;
+        }
     }
 
+    if (recording && recorder.lastHashStep() != frame) recorder.hash(frame, physics.stateHash());
+    PROFILE_EXPORT("trace.json");
+
+    engine.shaderReloader.reset();
     glfwDestroyWindow(engine.window);
     glfwTerminate();
     return 0;
@@ -0,0 +1,241 @@
+// Headless domain-decomposed run: the bodies are split across processes that exchange ghosts
+// every force pass (distributed.h). Locally the processes are forked and talk over socketpairs;
+// built with -DCOSMOS_MPI and started by mpirun they talk over MPI instead.
+//
+//   ./cluster.bash --ranks 4 --bodies 20000 --steps 200 --check
+//
+// --ranks <n> processes to fork (ignored under MPI); --bodies <n> fixed-seed random disc, or
+// --scenario <file>; --steps <n>, --dt <seconds>; --theta <x> ghost opening angle, 0 = exact;
+// --leaf <n> bodies per ghost leaf; --balance-every <steps> rebalance interval, 0 = never;
+// --integrator euler|leapfrog; --reorder Morton-sorts each rank's bodies at every rebalance;
+// --check also runs the same bodies in one process and compares.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <omp.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef COSMOS_MPI
+#include <mpi.h>
+#endif
+
+#include "distributed.h"
+#include "scenario.h"
+#include "transport.h"
+
+using namespace std;
+
+struct Options {
+    int ranks = 2;
+    size_t bodies = 10000;
+    string scenarioPath;
+    uint64_t steps = 100, balanceEvery = 20;
+    double dt = 3600.0, theta = 0.5;
+    size_t leafSize = 32;
+    Integrator integrator = Integrator::Leapfrog;
+    bool check = false, reorder = false;
+};
+
+struct RankStats {
+    double computeSeconds, commSeconds;
+    uint64_t bodies, ghosts, bytesSent, migrated;
+};
+
+// The benchmark disc (bench.cpp): a central star and n - 1 light bodies on circular orbits
+static void makeDisc(Bodies& b, size_t n) {
+    mt19937_64 rng(42);
+    uniform_real_distribution<double> radius(5e10, 5e12), angle(0.0, 2.0 * M_PI), height(-1e9, 1e9);
+    const double G = 6.67430e-11;
+
+    b.clear();
+    b.reserve(n);
+    b.add(0, 0, 0, 0, 0, 0, 1.989e30, 6.96e8);
+    for (size_t i = 1; i < n; ++i) {
+        double r = radius(rng), a = angle(rng);
+        double v = sqrt(G * 1.989e30 / r);
+        b.add(r * cos(a), height(rng), r * sin(a), -v * sin(a), 0, v * cos(a), 1e22, 1e6);
+    }
+}
+
+static double totalEnergy(const Bodies& b, double G) {
+    double energy = 0.0;
+    const long n = (long)b.size();
+    #pragma omp parallel for reduction(+:energy) schedule(dynamic, 64)
+    for (long i = 0; i < n; ++i) {
+        if (b.parent[i] >= 0) continue;
+        double e = 0.5 * b.mass[i] * (b.vx[i] * b.vx[i] + b.vy[i] * b.vy[i] + b.vz[i] * b.vz[i]);
+        for (long j = i + 1; j < n; ++j) {
+            if (b.parent[j] >= 0) continue;
+            double dx = b.x[j] - b.x[i], dy = b.y[j] - b.y[i], dz = b.z[j] - b.z[i];
+            double r = sqrt(dx * dx + dy * dy + dz * dz);
+            if (r > 0.0) e -= G * b.mass[i] * b.mass[j] / r;
+        }
+        energy += e;
+    }
+    return energy;
+}
+
+static int runRank(Transport& transport, const Options& opt) {
+    Bodies all;
+    if (!opt.scenarioPath.empty()) {
+        if (!loadScenarioBodies(opt.scenarioPath.c_str(), all)) return 1;
+    } else {
+        makeDisc(all, opt.bodies);
+    }
+    const bool root = transport.rank() == 0;
+
+    DistributedPhysics sim(transport);
+    sim.physics.minDistance = 1e5;
+    sim.physics.integrator = opt.integrator;
+    sim.theta = opt.theta;
+    sim.leafSize = opt.leafSize;
+    sim.reorder = opt.reorder;
+    if (!sim.distribute(all)) return 1;
+    double e0 = opt.check && root ? totalEnergy(all, sim.physics.gravConst) : 0.0;
+
+    auto start = chrono::steady_clock::now();
+    for (uint64_t k = 1; k <= opt.steps; ++k) {
+        if (!sim.step(opt.dt)) {
+            cerr << "Rank " << transport.rank() << ": step " << k << " failed" << endl;
+            return 1;
+        }
+        if (opt.balanceEvery > 0 && k % opt.balanceEvery == 0 && k < opt.steps && !sim.rebalance()) return 1;
+    }
+    double wall = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    RankStats mine = { sim.computeSeconds, sim.commSeconds, sim.physics.bodies.size(), sim.ghostCount(), sim.bytesSent, sim.migrated };
+    vector<char> blob(sizeof(mine));
+    memcpy(blob.data(), &mine, sizeof(mine));
+    vector<vector<char>> stats;
+    Bodies result;
+    if (!transport.allGather(blob, stats) || !sim.gather(result)) return 1;
+    if (!root) return 0;
+
+    printf("%d ranks, %zu bodies, %llu steps in %.2f s: %.3g body-steps/s\n", transport.size(), result.size(),
+           (unsigned long long)opt.steps, wall, result.size() * (double)opt.steps / max(wall, 1e-9));
+    double slowest = 0.0, mean = 0.0;
+    for (size_t q = 0; q < stats.size(); ++q) {
+        RankStats s;
+        memcpy(&s, stats[q].data(), sizeof(s));
+        printf("  rank %zu: %6llu bodies %6llu ghosts  compute %.2f s  comm %.2f s  sent %.1f MB  migrated %llu\n", q,
+               (unsigned long long)s.bodies, (unsigned long long)s.ghosts, s.computeSeconds, s.commSeconds,
+               s.bytesSent / 1e6, (unsigned long long)s.migrated);
+        slowest = max(slowest, s.computeSeconds);
+        mean += s.computeSeconds / stats.size();
+    }
+    printf("  load imbalance (slowest / mean compute): %.3f\n", slowest / max(mean, 1e-12));
+
+    if (opt.check) {
+        PhysicsEngine single;
+        single.minDistance = 1e5;
+        single.integrator = opt.integrator;
+        single.bodies = all;
+        single.markBodiesChanged();
+        for (uint64_t k = 0; k < opt.steps; ++k) single.step(opt.dt);
+
+        double extent = 0.0, deviation = 0.0;
+        for (size_t i = 0; i < result.size(); ++i) {
+            const Bodies& s = single.bodies;
+            extent = max(extent, sqrt(s.x[i] * s.x[i] + s.y[i] * s.y[i] + s.z[i] * s.z[i]));
+            double dx = result.x[i] - s.x[i], dy = result.y[i] - s.y[i], dz = result.z[i] - s.z[i];
+            deviation = max(deviation, sqrt(dx * dx + dy * dy + dz * dz));
+        }
+        double e1 = totalEnergy(result, single.gravConst), eSingle = totalEnergy(single.bodies, single.gravConst);
+        printf("  max position deviation from one process: %.3e m (%.3e of the system radius)\n", deviation,
+               deviation / max(extent, 1e-300));
+        printf("  energy error: %.3e distributed, %.3e one process\n", fabs((e1 - e0) / e0), fabs((eSingle - e0) / e0));
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--check") {
+            opt.check = true;
+        } else if (arg == "--ranks" && hasValue) {
+            opt.ranks = max(1, atoi(argv[++i]));
+        } else if (arg == "--bodies" && hasValue) {
+            opt.bodies = max<size_t>(1, strtoull(argv[++i], nullptr, 10));
+        } else if (arg == "--scenario" && hasValue) {
+            opt.scenarioPath = argv[++i];
+        } else if (arg == "--steps" && hasValue) {
+            opt.steps = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--dt" && hasValue) {
+            opt.dt = atof(argv[++i]);
+        } else if (arg == "--theta" && hasValue) {
+            opt.theta = atof(argv[++i]);
+        } else if (arg == "--leaf" && hasValue) {
+            opt.leafSize = max<size_t>(1, strtoull(argv[++i], nullptr, 10));
+        } else if (arg == "--balance-every" && hasValue) {
+            opt.balanceEvery = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--reorder") {
+            opt.reorder = true;
+        } else if (arg == "--integrator" && hasValue) {
+            string kind = argv[++i];
+            if (kind == "euler") opt.integrator = Integrator::SemiImplicitEuler;
+            else if (kind == "leapfrog") opt.integrator = Integrator::Leapfrog;
+            else {
+                cerr << "Distributed runs support euler and leapfrog, not " << kind << endl;
+                return 1;
+            }
+        } else {
+            cerr << "Unknown option: " << arg << endl;
+            return 1;
+        }
+    }
+
+#ifdef COSMOS_MPI
+    MPI_Init(&argc, &argv);
+    int status;
+    {
+        MpiTransport transport;
+        status = runRank(transport, opt);
+    }
+    MPI_Finalize();
+    return status;
+#else
+    // Split the cores between the ranks so OpenMP inside each one does not oversubscribe
+    omp_set_num_threads(max(1, omp_get_num_procs() / opt.ranks));
+    auto endpoints = SocketTransport::createLocal(opt.ranks);
+    if (endpoints.empty()) return 1;
+
+    vector<pid_t> children;
+    for (int r = 1; r < opt.ranks; ++r) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            return 1;
+        }
+        if (pid == 0) {
+            for (int other = 0; other < opt.ranks; ++other) {
+                if (other != r) endpoints[other].reset();
+            }
+            _exit(runRank(*endpoints[r], opt));
+        }
+        children.push_back(pid);
+    }
+    for (int r = 1; r < opt.ranks; ++r) endpoints[r].reset();
+
+    int status = runRank(*endpoints[0], opt);
+    endpoints[0].reset(); // lets a rank still waiting on rank 0 fail instead of hanging
+    for (pid_t pid : children) {
+        int childStatus = 0;
+        waitpid(pid, &childStatus, 0);
+        if (!WIFEXITED(childStatus) || WEXITSTATUS(childStatus) != 0) status = 1;
+    }
+    return status;
+#endif
+}
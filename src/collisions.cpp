@@ -0,0 +1,128 @@
+#include "collisions.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Smallest t in [0, 1] at which |s + d t| = R, where s is the separation at the start of the
+// step and d the change in separation over it. Overlapping pairs collide at t = 0.
+static bool sweptContact(const double s[3], const double d[3], double R, double& t) {
+    double c = s[0] * s[0] + s[1] * s[1] + s[2] * s[2] - R * R;
+    if (c <= 0.0) {
+        t = 0.0;
+        return true;
+    }
+    double A = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+    double B = s[0] * d[0] + s[1] * d[1] + s[2] * d[2];
+    if (A == 0.0 || B >= 0.0) return false; // not approaching
+    double disc = B * B - A * c;
+    if (disc < 0.0) return false;
+    t = (-B - std::sqrt(disc)) / A;
+    return t <= 1.0;
+}
+
+void CollisionDetector::find(const Bodies& bodies, const double* x0, const double* y0, const double* z0,
+                             std::vector<Collision>& out) {
+    out.clear();
+    const size_t n = bodies.size();
+    if (n < 2) return;
+
+    const double* p0[3] = { x0, y0, z0 };
+    const double* p1[3] = { bodies.x.data(), bodies.y.data(), bodies.z.data() };
+    const double* radius = bodies.radius.data();
+
+    // Sweep along the axis where bodies are most spread out, so few intervals overlap
+    int axis = 0;
+    double widest = -1.0;
+    for (int a = 0; a < 3; ++a) {
+        auto [lo, hi] = std::minmax_element(p1[a], p1[a] + n);
+        if (*hi - *lo > widest) {
+            widest = *hi - *lo;
+            axis = a;
+        }
+    }
+
+    intervals.clear();
+    for (size_t i = 0; i < n; ++i) {
+        if (radius[i] <= 0.0) continue; // points and absorbed bodies never collide
+        double a = p0[axis][i], b = p1[axis][i];
+        intervals.push_back({ std::min(a, b) - radius[i], std::max(a, b) + radius[i], (uint32_t)i });
+    }
+    std::sort(intervals.begin(), intervals.end(), [](const Interval& l, const Interval& r) { return l.lo < r.lo; });
+
+    const long m = (long)intervals.size();
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (long k = 0; k < m; ++k) {
+        const uint32_t i = intervals[k].body;
+        for (long l = k + 1; l < m && intervals[l].lo <= intervals[k].hi; ++l) {
+            const uint32_t j = intervals[l].body;
+            const double R = radius[i] + radius[j];
+
+            double s[3], d[3];
+            bool apart = false;
+            for (int a = 0; a < 3 && !apart; ++a) {
+                s[a] = p0[a][j] - p0[a][i];
+                d[a] = (p1[a][j] - p0[a][j]) - (p1[a][i] - p0[a][i]);
+                // Swept boxes must overlap on every axis, not just the sweep axis
+                double loI = std::min(p0[a][i], p1[a][i]) - radius[i], hiI = std::max(p0[a][i], p1[a][i]) + radius[i];
+                double loJ = std::min(p0[a][j], p1[a][j]) - radius[j], hiJ = std::max(p0[a][j], p1[a][j]) + radius[j];
+                apart = hiI < loJ || hiJ < loI;
+            }
+            double t;
+            if (apart || !sweptContact(s, d, R, t)) continue;
+
+            // Contacts are rare; a critical section is cheaper than per-thread buffers
+            #pragma omp critical(collisionsFound)
+            out.push_back({ std::min(i, j), std::max(i, j), t });
+        }
+    }
+
+    std::sort(out.begin(), out.end(), [](const Collision& l, const Collision& r) {
+        if (l.t != r.t) return l.t < r.t;
+        return l.a != r.a ? l.a < r.a : l.b < r.b;
+    });
+}
+
+size_t mergeCollisions(Bodies& bodies, const std::vector<Collision>& collisions) {
+    size_t merges = 0;
+    const size_t n = bodies.size();
+
+    for (const Collision& c : collisions) {
+        const size_t a = c.a, b = c.b;
+        if (bodies.absorbed(a) || bodies.absorbed(b)) continue;
+
+        double ma = bodies.mass[a], mb = bodies.mass[b], m = ma + mb;
+        double wa = m > 0.0 ? ma / m : 0.5, wb = 1.0 - wa;
+
+        // Centre of mass moves linearly, so weighting end-of-step state is exact for the merged body
+        bodies.x[a] = wa * bodies.x[a] + wb * bodies.x[b];
+        bodies.y[a] = wa * bodies.y[a] + wb * bodies.y[b];
+        bodies.z[a] = wa * bodies.z[a] + wb * bodies.z[b];
+        bodies.vx[a] = wa * bodies.vx[a] + wb * bodies.vx[b];
+        bodies.vy[a] = wa * bodies.vy[a] + wb * bodies.vy[b];
+        bodies.vz[a] = wa * bodies.vz[a] + wb * bodies.vz[b];
+        bodies.ax[a] = wa * bodies.ax[a] + wb * bodies.ax[b];
+        bodies.ay[a] = wa * bodies.ay[a] + wb * bodies.ay[b];
+        bodies.az[a] = wa * bodies.az[a] + wb * bodies.az[b];
+        bodies.mass[a] = m;
+        bodies.radius[a] = std::cbrt(bodies.radius[a] * bodies.radius[a] * bodies.radius[a] +
+                                     bodies.radius[b] * bodies.radius[b] * bodies.radius[b]);
+
+        // Absorbing a top-level body makes the result a source of gravity in its own right
+        if (bodies.parent[b] < 0 && bodies.parent[a] >= 0) bodies.parent[a] = -1;
+
+        // b's satellites now orbit the survivor; a < b < child keeps parents ahead of children
+        for (size_t k = b + 1; k < n; ++k) {
+            if (bodies.parent[k] == (int)b) bodies.parent[k] = (int)a;
+        }
+
+        bodies.mass[b] = 0.0;
+        bodies.radius[b] = 0.0;
+        bodies.parent[b] = (int)a;
+        bodies.merged[b] = 1;
+        bodies.x[b] = bodies.x[a];   bodies.y[b] = bodies.y[a];   bodies.z[b] = bodies.z[a];
+        bodies.vx[b] = bodies.vx[a]; bodies.vy[b] = bodies.vy[a]; bodies.vz[b] = bodies.vz[a];
+        bodies.ax[b] = bodies.ax[a]; bodies.ay[b] = bodies.ay[a]; bodies.az[b] = bodies.az[a];
+        ++merges;
+    }
+    return merges;
+}
@@ -0,0 +1,60 @@
+#include "diagnostics.h"
+
+#include <cmath>
+#include <iostream>
+
+using namespace std;
+
+DiagnosticsWriter::~DiagnosticsWriter() {
+    out.reset(); // flushes before the file closes
+}
+
+bool DiagnosticsWriter::open(const string& path) {
+    file.open(path, ios::trunc);
+    if (!file) {
+        cerr << "Could not open diagnostics file: " << path << endl;
+        return false;
+    }
+    string ext = path.substr(min(path.size(), path.rfind('.')));
+    json = ext == ".json" || ext == ".jsonl";
+    out = make_unique<LogChannel>(file);
+    if (!json) {
+        out->print("time,dt,kinetic,potential,energy,energyError,px,py,pz,");
+        out->print("Lx,Ly,Lz,angularMomentumError,wallSeconds\n");
+    }
+    written = 0;
+    start = chrono::steady_clock::now();
+    return true;
+}
+
+void DiagnosticsWriter::write(const Diagnostics& d, double dt) {
+    if (!out) return;
+    const double* L = d.angularMomentum;
+    if (written == 0) {
+        energy0 = d.energy();
+        for (int a = 0; a < 3; ++a) angularMomentum0[a] = L[a];
+    }
+    // Relative drift; an exactly zero reference (e.g. a lone body) reports the absolute change
+    double dE = fabs(d.energy() - energy0) / (energy0 != 0.0 ? fabs(energy0) : 1.0);
+    double dL2 = 0.0, L02 = 0.0;
+    for (int a = 0; a < 3; ++a) {
+        dL2 += (L[a] - angularMomentum0[a]) * (L[a] - angularMomentum0[a]);
+        L02 += angularMomentum0[a] * angularMomentum0[a];
+    }
+    double dL = sqrt(dL2) / (L02 > 0.0 ? sqrt(L02) : 1.0);
+    double wall = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    if (json) {
+        out->print("{\"time\":%.17g,\"dt\":%.9g,\"kinetic\":%.17g,\"potential\":%.17g,\"energy\":%.17g,",
+                   d.time, dt, d.kinetic, d.potential, d.energy());
+        out->print("\"energyError\":%.6e,\"momentum\":[%.17g,%.17g,%.17g],", dE,
+                   d.momentum[0], d.momentum[1], d.momentum[2]);
+        out->print("\"angularMomentum\":[%.17g,%.17g,%.17g],\"angularMomentumError\":%.6e,\"wallSeconds\":%.6f}\n",
+                   L[0], L[1], L[2], dL, wall);
+    } else {
+        out->print("%.17g,%.9g,%.17g,%.17g,%.17g,%.6e,", d.time, dt, d.kinetic, d.potential, d.energy(), dE);
+        out->print("%.17g,%.17g,%.17g,%.17g,%.17g,%.17g,%.6e,%.6f\n", d.momentum[0], d.momentum[1], d.momentum[2],
+                   L[0], L[1], L[2], dL, wall);
+    }
+    ++written;
+}
@@ -0,0 +1,415 @@
+#include "distributed.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <unordered_map>
+
+#include "profiler.h"
+
+using namespace std;
+
+namespace {
+
+// Wire format of one body; the parent is named by global id so indices can be rebuilt anywhere
+struct PackedBody {
+    uint64_t id;
+    int64_t parentId; // -1 for top-level
+    double x, y, z, vx, vy, vz, ax, ay, az, mass, radius;
+};
+
+struct PackedGhost {
+    double x, y, z, mass;
+};
+
+// A top-level body standing in for its group when the domains are cut
+struct OrbItem {
+    double pos[3];
+    double weight;
+    uint64_t id;
+};
+
+template <typename T>
+void append(vector<char>& out, const T& value) {
+    size_t at = out.size();
+    out.resize(at + sizeof(T));
+    memcpy(out.data() + at, &value, sizeof(T));
+}
+
+template <typename T>
+vector<T> unpack(const vector<char>& in) {
+    vector<T> out(in.size() / sizeof(T));
+    if (!out.empty()) memcpy(out.data(), in.data(), out.size() * sizeof(T));
+    return out;
+}
+
+double seconds(chrono::steady_clock::time_point since) {
+    return chrono::duration<double>(chrono::steady_clock::now() - since).count();
+}
+
+// Index of the top-level body each body hangs from; parents always precede their children
+vector<int> groupRoots(const Bodies& b) {
+    vector<int> root(b.size());
+    for (size_t i = 0; i < b.size(); ++i) root[i] = b.parent[i] < 0 ? (int)i : root[b.parent[i]];
+    return root;
+}
+
+// Splits items[begin, end) between ranks [r0, r1) along the axis of widest spread, at the
+// point where the ranks on each side receive weight in proportion to their number.
+// Depends only on the items, so every rank computes the same boxes from the same input.
+void bisect(vector<OrbItem>& items, size_t begin, size_t end, int r0, int r1, DomainBox box, vector<DomainBox>& out) {
+    if (r1 - r0 == 1) {
+        out[r0] = box;
+        return;
+    }
+
+    int axis = 0;
+    if (end > begin) {
+        double lo[3], hi[3];
+        for (int k = 0; k < 3; ++k) lo[k] = hi[k] = items[begin].pos[k];
+        for (size_t i = begin; i < end; ++i) {
+            for (int k = 0; k < 3; ++k) {
+                lo[k] = min(lo[k], items[i].pos[k]);
+                hi[k] = max(hi[k], items[i].pos[k]);
+            }
+        }
+        for (int k = 1; k < 3; ++k) {
+            if (hi[k] - lo[k] > hi[axis] - lo[axis]) axis = k;
+        }
+    }
+    sort(items.begin() + begin, items.begin() + end, [axis](const OrbItem& a, const OrbItem& b) {
+        return a.pos[axis] != b.pos[axis] ? a.pos[axis] < b.pos[axis] : a.id < b.id;
+    });
+
+    // Without any measured work, fall back to splitting by count
+    double total = 0.0;
+    for (size_t i = begin; i < end; ++i) total += items[i].weight;
+    bool byCount = !(total > 0.0);
+    if (byCount) total = (double)(end - begin);
+
+    int mid = r0 + (r1 - r0) / 2;
+    double target = total * (mid - r0) / (r1 - r0);
+    size_t split = begin;
+    double below = 0.0;
+    while (split < end) {
+        double w = byCount ? 1.0 : items[split].weight;
+        if (below + 0.5 * w > target) break;
+        below += w;
+        ++split;
+    }
+
+    double cut;
+    if (end == begin) cut = clamp(0.0, box.lo[axis], box.hi[axis]);
+    else if (split == begin) cut = items[begin].pos[axis];
+    else if (split == end) cut = nextafter(items[end - 1].pos[axis], numeric_limits<double>::infinity());
+    else cut = 0.5 * (items[split - 1].pos[axis] + items[split].pos[axis]);
+
+    DomainBox left = box, right = box;
+    left.hi[axis] = cut;
+    right.lo[axis] = cut;
+    bisect(items, begin, split, r0, mid, left, out);
+    bisect(items, split, end, mid, r1, right, out);
+}
+
+vector<DomainBox> decompose(vector<OrbItem>& items, int ranks) {
+    const double inf = numeric_limits<double>::infinity();
+    DomainBox everywhere = { { -inf, -inf, -inf }, { inf, inf, inf } };
+    vector<DomainBox> boxes(ranks);
+    bisect(items, 0, items.size(), 0, ranks, everywhere, boxes);
+    return boxes;
+}
+
+double distanceToBox(const double p[3], const DomainBox& box) {
+    double d2 = 0.0;
+    for (int k = 0; k < 3; ++k) {
+        double d = max({ box.lo[k] - p[k], 0.0, p[k] - box.hi[k] });
+        d2 += d * d;
+    }
+    return sqrt(d2);
+}
+
+} // namespace
+
+DistributedPhysics::DistributedPhysics(Transport& transport) : transport(transport) {
+    const double inf = numeric_limits<double>::infinity();
+    boxes.assign(transport.size(), { { -inf, -inf, -inf }, { inf, inf, inf } });
+    physics.beforeForces = [this]() { exchangeGhosts(); };
+}
+
+int DistributedPhysics::owner(double x, double y, double z) const {
+    for (size_t q = 0; q < boxes.size(); ++q) {
+        if (boxes[q].contains(x, y, z)) return (int)q;
+    }
+    return rank(); // only NaN positions fall outside every box; they stay where they are
+}
+
+bool DistributedPhysics::distribute(const Bodies& all) {
+    if (physics.integrator == Integrator::WisdomHolman || physics.collisions || physics.regularizationRadius > 0.0) {
+        cerr << "Distributed runs support semi-implicit Euler and leapfrog without collisions or regularization" << endl;
+        return false;
+    }
+    if (physics.reorderInterval > 0) {
+        cerr << "Distributed runs reorder through DistributedPhysics::reorder, so ids follow the bodies" << endl;
+        return false;
+    }
+
+    vector<int> root = groupRoots(all);
+    vector<double> groupSize(all.size(), 0.0);
+    for (size_t i = 0; i < all.size(); ++i) groupSize[root[i]] += 1.0;
+
+    vector<OrbItem> items;
+    for (size_t i = 0; i < all.size(); ++i) {
+        if (all.parent[i] < 0) items.push_back({ { all.x[i], all.y[i], all.z[i] }, groupSize[i], i });
+    }
+    boxes = decompose(items, transport.size());
+
+    Bodies& b = physics.bodies;
+    b.clear();
+    ids.clear();
+    vector<int> local(all.size(), -1);
+    for (size_t i = 0; i < all.size(); ++i) {
+        int r = root[i];
+        if (owner(all.x[r], all.y[r], all.z[r]) != rank()) continue;
+        local[i] = (int)b.add(all.x[i], all.y[i], all.z[i], all.vx[i], all.vy[i], all.vz[i], all.mass[i], all.radius[i],
+                              all.parent[i] < 0 ? -1 : local[all.parent[i]]);
+        ids.push_back(i);
+    }
+    workSeconds = 0.0;
+    physics.markBodiesChanged();
+    return true;
+}
+
+bool DistributedPhysics::step(double dt) {
+    auto start = chrono::steady_clock::now();
+    double commBefore = commSeconds;
+    physics.step(dt);
+    double compute = seconds(start) - (commSeconds - commBefore);
+    computeSeconds += compute;
+    workSeconds += compute;
+    return !failed && migrate();
+}
+
+// Runs inside PhysicsEngine::computeAccelerations, before the kernel reads the ghost arrays
+void DistributedPhysics::exchangeGhosts() {
+    PROFILE_ZONE("ghosts");
+    auto start = chrono::steady_clock::now();
+    const Bodies& b = physics.bodies;
+    const int p = transport.size(), me = rank();
+
+    // Leaves of at most leafSize sources, by recursive bisection at the median
+    vector<int> sources;
+    for (size_t i = 0; i < b.size(); ++i) {
+        if (b.parent[i] < 0 && b.mass[i] > 0.0) sources.push_back((int)i);
+    }
+    vector<pair<size_t, size_t>> leaves, pending = { { 0, sources.size() } };
+    const size_t limit = max<size_t>(leafSize, 1);
+    while (!pending.empty()) {
+        auto [begin, end] = pending.back();
+        pending.pop_back();
+        if (end - begin <= limit) {
+            if (end > begin) leaves.push_back({ begin, end });
+            continue;
+        }
+        double lo[3] = { b.x[sources[begin]], b.y[sources[begin]], b.z[sources[begin]] }, hi[3] = { lo[0], lo[1], lo[2] };
+        for (size_t k = begin; k < end; ++k) {
+            double q[3] = { b.x[sources[k]], b.y[sources[k]], b.z[sources[k]] };
+            for (int a = 0; a < 3; ++a) {
+                lo[a] = min(lo[a], q[a]);
+                hi[a] = max(hi[a], q[a]);
+            }
+        }
+        int axis = 0;
+        for (int a = 1; a < 3; ++a) {
+            if (hi[a] - lo[a] > hi[axis] - lo[axis]) axis = a;
+        }
+        const vector<double>& c = axis == 0 ? b.x : (axis == 1 ? b.y : b.z);
+        size_t mid = begin + (end - begin) / 2;
+        nth_element(sources.begin() + begin, sources.begin() + mid, sources.begin() + end,
+                    [&c](int i, int j) { return c[i] != c[j] ? c[i] < c[j] : i < j; });
+        pending.push_back({ begin, mid });
+        pending.push_back({ mid, end });
+    }
+
+    vector<vector<char>> outgoing(p), incoming;
+    for (auto [begin, end] : leaves) {
+        double m = 0.0, com[3] = { 0.0, 0.0, 0.0 }, lo[3], hi[3];
+        for (int a = 0; a < 3; ++a) {
+            lo[a] = numeric_limits<double>::infinity();
+            hi[a] = -lo[a];
+        }
+        for (size_t k = begin; k < end; ++k) {
+            int i = sources[k];
+            double q[3] = { b.x[i], b.y[i], b.z[i] };
+            m += b.mass[i];
+            for (int a = 0; a < 3; ++a) {
+                com[a] += b.mass[i] * q[a];
+                lo[a] = min(lo[a], q[a]);
+                hi[a] = max(hi[a], q[a]);
+            }
+        }
+        for (int a = 0; a < 3; ++a) com[a] /= m;
+        double size = max({ hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2] });
+
+        for (int q = 0; q < p; ++q) {
+            if (q == me) continue;
+            if (size < theta * distanceToBox(com, boxes[q])) {
+                append(outgoing[q], PackedGhost{ com[0], com[1], com[2], m });
+            } else {
+                for (size_t k = begin; k < end; ++k) {
+                    int i = sources[k];
+                    append(outgoing[q], PackedGhost{ b.x[i], b.y[i], b.z[i], b.mass[i] });
+                }
+            }
+        }
+    }
+    for (int q = 0; q < p; ++q) bytesSent += outgoing[q].size();
+
+    physics.ghostX.clear();
+    physics.ghostY.clear();
+    physics.ghostZ.clear();
+    physics.ghostMass.clear();
+    if (!transport.allToAll(outgoing, incoming)) {
+        failed = true;
+    } else {
+        // Rank order, so the kernel sums ghosts in the same order on every run
+        for (int q = 0; q < p; ++q) {
+            if (q == me) continue;
+            for (const PackedGhost& g : unpack<PackedGhost>(incoming[q])) {
+                physics.ghostX.push_back(g.x);
+                physics.ghostY.push_back(g.y);
+                physics.ghostZ.push_back(g.z);
+                physics.ghostMass.push_back(g.mass);
+            }
+        }
+    }
+    commSeconds += seconds(start);
+}
+
+bool DistributedPhysics::migrate() {
+    PROFILE_ZONE("migrate");
+    auto start = chrono::steady_clock::now();
+    Bodies& b = physics.bodies;
+    const int p = transport.size(), me = rank();
+
+    vector<int> root = groupRoots(b), dest(b.size());
+    vector<vector<char>> outgoing(p), incoming;
+    for (size_t i = 0; i < b.size(); ++i) {
+        int r = root[i];
+        dest[i] = (size_t)r == i ? owner(b.x[i], b.y[i], b.z[i]) : dest[r];
+        if (dest[i] == me) continue;
+        int64_t parentId = b.parent[i] < 0 ? -1 : (int64_t)ids[b.parent[i]];
+        append(outgoing[dest[i]], PackedBody{ ids[i], parentId, b.x[i], b.y[i], b.z[i], b.vx[i], b.vy[i], b.vz[i],
+                                              b.ax[i], b.ay[i], b.az[i], b.mass[i], b.radius[i] });
+    }
+    for (int q = 0; q < p; ++q) bytesSent += outgoing[q].size();
+    if (!transport.allToAll(outgoing, incoming)) {
+        commSeconds += seconds(start);
+        return false;
+    }
+
+    // Keep the staying bodies in order, then append arrivals; parents still precede children
+    bool changed = false;
+    vector<uint32_t> stay;
+    stay.reserve(b.size());
+    for (size_t i = 0; i < b.size(); ++i) {
+        if (dest[i] == me) stay.push_back((uint32_t)i);
+        else ++migrated;
+    }
+    if (stay.size() < b.size()) {
+        changed = true;
+        b.permute(stay);
+        for (size_t k = 0; k < stay.size(); ++k) ids[k] = ids[stay[k]];
+        ids.resize(stay.size());
+    }
+
+    for (int q = 0; q < p; ++q) {
+        if (q == me) continue;
+        unordered_map<uint64_t, int> arrived;
+        for (const PackedBody& in : unpack<PackedBody>(incoming[q])) {
+            int parent = in.parentId < 0 ? -1 : arrived[(uint64_t)in.parentId];
+            size_t i = b.add(in.x, in.y, in.z, in.vx, in.vy, in.vz, in.mass, in.radius, parent);
+            b.ax[i] = in.ax;
+            b.ay[i] = in.ay;
+            b.az[i] = in.az;
+            ids.push_back(in.id);
+            arrived[in.id] = (int)i;
+            changed = true;
+        }
+    }
+    // Every body carries the acceleration computed for it, so a leapfrog step can reuse them
+    if (changed) physics.markBodiesMoved();
+    commSeconds += seconds(start);
+    return true;
+}
+
+bool DistributedPhysics::rebalance() {
+    PROFILE_ZONE("rebalance");
+    const Bodies& b = physics.bodies;
+    vector<int> root = groupRoots(b);
+    vector<double> groupSize(b.size(), 0.0);
+    for (size_t i = 0; i < b.size(); ++i) groupSize[root[i]] += 1.0;
+
+    // Cost per body on this rank: the force pass is shared evenly by its bodies
+    double perBody = b.size() > 0 ? workSeconds / (double)b.size() : 0.0;
+    vector<char> mine;
+    for (size_t i = 0; i < b.size(); ++i) {
+        if (b.parent[i] < 0) append(mine, OrbItem{ { b.x[i], b.y[i], b.z[i] }, perBody * groupSize[i], ids[i] });
+    }
+    vector<vector<char>> all;
+    if (!transport.allGather(mine, all)) return false;
+
+    vector<OrbItem> items;
+    for (const vector<char>& blob : all) {
+        vector<OrbItem> part = unpack<OrbItem>(blob);
+        items.insert(items.end(), part.begin(), part.end());
+    }
+    boxes = decompose(items, transport.size());
+    workSeconds = 0.0;
+    if (!migrate()) return false;
+    if (reorder) {
+        Bodies& local = physics.bodies;
+        sorter.order(local, sortOrder);
+        local.permute(sortOrder);
+        vector<uint64_t> sortedIds(ids.size());
+        for (size_t k = 0; k < sortOrder.size(); ++k) sortedIds[k] = ids[sortOrder[k]];
+        ids.swap(sortedIds);
+        physics.markBodiesMoved();
+    }
+    return true;
+}
+
+bool DistributedPhysics::gather(Bodies& all) {
+    const Bodies& b = physics.bodies;
+    vector<char> mine;
+    for (size_t i = 0; i < b.size(); ++i) {
+        int64_t parentId = b.parent[i] < 0 ? -1 : (int64_t)ids[b.parent[i]];
+        append(mine, PackedBody{ ids[i], parentId, b.x[i], b.y[i], b.z[i], b.vx[i], b.vy[i], b.vz[i],
+                                 b.ax[i], b.ay[i], b.az[i], b.mass[i], b.radius[i] });
+    }
+    vector<vector<char>> blobs;
+    if (!transport.allGather(mine, blobs)) return false;
+
+    size_t total = 0;
+    for (const vector<char>& blob : blobs) total += blob.size() / sizeof(PackedBody);
+    all.clear();
+    all.resize(total);
+    for (const vector<char>& blob : blobs) {
+        for (const PackedBody& in : unpack<PackedBody>(blob)) {
+            if (in.id >= total) {
+                cerr << "Gathered body id " << in.id << " is out of range" << endl;
+                return false;
+            }
+            size_t i = in.id;
+            all.x[i] = in.x; all.y[i] = in.y; all.z[i] = in.z;
+            all.vx[i] = in.vx; all.vy[i] = in.vy; all.vz[i] = in.vz;
+            all.ax[i] = in.ax; all.ay[i] = in.ay; all.az[i] = in.az;
+            all.mass[i] = in.mass;
+            all.radius[i] = in.radius;
+            all.parent[i] = (int)in.parentId;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,214 @@
+#include "ephemeris.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const size_t EPHEMERIS_ALIGN = 64;
+
+static uint64_t alignUp(uint64_t v) {
+    return (v + EPHEMERIS_ALIGN - 1) & ~uint64_t(EPHEMERIS_ALIGN - 1);
+}
+
+// Steps from physics.time to `target` without overshooting it
+static void advanceTo(PhysicsEngine& physics, double target, double maxStep) {
+    double remaining = target - physics.time;
+    while (remaining > 0.0) {
+        double h = min(remaining, maxStep);
+        physics.step(h);
+        remaining -= h;
+    }
+    physics.time = target;
+}
+
+bool buildEphemeris(const char* path, PhysicsEngine& physics, double span, double segmentLength,
+                    uint32_t coefficients, double maxStep) {
+    if (span <= 0.0 || segmentLength <= 0.0 || coefficients == 0 || maxStep <= 0.0) {
+        cerr << "Invalid ephemeris parameters" << endl;
+        return false;
+    }
+    if (physics.reorderInterval > 0) {
+        cerr << "Ephemerides list bodies by scenario index; build them with reorderInterval = 0" << endl;
+        return false;
+    }
+
+    const size_t n = physics.bodies.size();
+    const uint32_t N = coefficients;
+
+    EphemerisHeader header = {};
+    memcpy(header.magic, EPHEMERIS_MAGIC, sizeof(EPHEMERIS_MAGIC));
+    header.version = EPHEMERIS_VERSION;
+    header.headerSize = sizeof(EphemerisHeader);
+    header.bodyCount = n;
+    header.coefficients = N;
+    header.segmentCount = (uint64_t)ceil(span / segmentLength);
+    header.startTime = physics.time;
+    header.segmentLength = segmentLength;
+    header.segmentStride = alignUp(n * 3 * N * sizeof(double));
+    header.dataOffset = alignUp(sizeof(EphemerisHeader));
+    header.fileSize = header.dataOffset + header.segmentCount * header.segmentStride;
+
+    string tmpPath = string(path) + ".tmp";
+    ofstream out(tmpPath, ios::binary | ios::trunc);
+    if (!out) {
+        cerr << "Could not write ephemeris: " << tmpPath << endl;
+        return false;
+    }
+    static const char zeros[EPHEMERIS_ALIGN] = {};
+    out.write((const char*)&header, sizeof(header));
+    out.write(zeros, (streamsize)(header.dataOffset - sizeof(header)));
+
+    // Node k sits at cos(π (k + ½) / N); visiting k = N-1 … 0 moves forward in time
+    vector<double> samples(size_t(N) * n * 3);  // [node][body][axis]
+    vector<double> block(header.segmentStride / sizeof(double), 0.0);
+    const Bodies& b = physics.bodies;
+    for (uint64_t s = 0; s < header.segmentCount; ++s) {
+        double a = header.startTime + s * segmentLength;
+        for (int k = (int)N - 1; k >= 0; --k) {
+            double node = cos(M_PI * (k + 0.5) / N);
+            advanceTo(physics, a + 0.5 * (node + 1.0) * segmentLength, maxStep);
+            double* row = &samples[size_t(k) * n * 3];
+            for (size_t i = 0; i < n; ++i) {
+                row[i * 3 + 0] = b.x[i];
+                row[i * 3 + 1] = b.y[i];
+                row[i * 3 + 2] = b.z[i];
+            }
+        }
+        advanceTo(physics, a + segmentLength, maxStep);
+
+        // c_j = (2 / N) Σ_k f(x_k) cos(j π (k + ½) / N), with c_0 halved
+        #pragma omp parallel for schedule(static)
+        for (long q = 0; q < (long)(n * 3); ++q) {
+            double* c = &block[size_t(q) * N];
+            for (uint32_t j = 0; j < N; ++j) {
+                double sum = 0.0;
+                for (uint32_t k = 0; k < N; ++k) sum += samples[size_t(k) * n * 3 + q] * cos(M_PI * j * (k + 0.5) / N);
+                c[j] = (j == 0 ? 1.0 : 2.0) * sum / N;
+            }
+        }
+        out.write((const char*)block.data(), (streamsize)header.segmentStride);
+    }
+
+    out.close();
+    if (!out) {
+        cerr << "Failed while writing ephemeris: " << tmpPath << endl;
+        remove(tmpPath.c_str());
+        return false;
+    }
+    if (rename(tmpPath.c_str(), path) != 0) {
+        cerr << "Could not replace ephemeris: " << path << endl;
+        return false;
+    }
+    return true;
+}
+
+EphemerisView::~EphemerisView() {
+    close();
+}
+
+bool EphemerisView::open(const char* path) {
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        cerr << "Could not open ephemeris: " << path << endl;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(EphemerisHeader)) {
+        cerr << "Ephemeris is truncated: " << path << endl;
+        ::close(fd);
+        return false;
+    }
+
+    void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        cerr << "Could not map ephemeris: " << path << endl;
+        return false;
+    }
+    mapping = map;
+    mappingSize = st.st_size;
+
+    const EphemerisHeader* h = (const EphemerisHeader*)map;
+    if (memcmp(h->magic, EPHEMERIS_MAGIC, sizeof(EPHEMERIS_MAGIC)) != 0) {
+        cerr << "Not an ephemeris file: " << path << endl;
+        close();
+        return false;
+    }
+    if (h->version != EPHEMERIS_VERSION || h->headerSize != sizeof(EphemerisHeader)) {
+        cerr << "Unsupported ephemeris version " << h->version << ": " << path << endl;
+        close();
+        return false;
+    }
+    if (h->fileSize != mappingSize || h->segmentCount == 0 || h->coefficients == 0 ||
+        h->segmentStride < h->bodyCount * 3 * h->coefficients * sizeof(double) ||
+        h->dataOffset + h->segmentCount * h->segmentStride > mappingSize) {
+        cerr << "Ephemeris size mismatch: " << path << endl;
+        close();
+        return false;
+    }
+
+    // Scrubbing jumps around the file
+    madvise(map, mappingSize, MADV_RANDOM);
+    header = h;
+    return true;
+}
+
+void EphemerisView::close() {
+    if (mapping) munmap(mapping, mappingSize);
+    mapping = nullptr;
+    mappingSize = 0;
+    header = nullptr;
+}
+
+void EphemerisView::evaluate(double t, Bodies& out) const {
+    const EphemerisHeader& h = *header;
+    const uint32_t N = h.coefficients;
+    const long n = (long)h.bodyCount;
+
+    double local = (t - h.startTime) / h.segmentLength;
+    uint64_t s = (uint64_t)min(max(floor(local), 0.0), double(h.segmentCount - 1));
+    double u = min(max(local - (double)s, 0.0), 1.0) * 2.0 - 1.0; // position within the segment, [-1, 1]
+    const double* block = (const double*)((const char*)mapping + h.dataOffset + s * h.segmentStride);
+    const double rate = 2.0 / h.segmentLength; // du/dt
+
+    double* pos[3] = { out.x.data(), out.y.data(), out.z.data() };
+    double* vel[3] = { out.vx.data(), out.vy.data(), out.vz.data() };
+
+    #pragma omp parallel for schedule(static)
+    for (long i = 0; i < n; ++i) {
+        for (int axis = 0; axis < 3; ++axis) {
+            const double* c = block + (size_t(i) * 3 + axis) * N;
+            // T_j(u) and T_j'(u) by their recurrences, summed together
+            double t0 = 1.0, t1 = u, d0 = 0.0, d1 = 1.0;
+            double f = c[0], df = 0.0;
+            if (N > 1) {
+                f += c[1] * t1;
+                df += c[1] * d1;
+            }
+            for (uint32_t j = 2; j < N; ++j) {
+                double t2 = 2.0 * u * t1 - t0;
+                double d2 = 2.0 * t1 + 2.0 * u * d1 - d0;
+                f += c[j] * t2;
+                df += c[j] * d2;
+                t0 = t1; t1 = t2;
+                d0 = d1; d1 = d2;
+            }
+            pos[axis][i] = f;
+            vel[axis][i] = df * rate;
+        }
+    }
+}
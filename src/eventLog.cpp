@@ -0,0 +1,138 @@
+#include "eventLog.h"
+
+#include <cinttypes>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+static const char* EVENT_LOG_MAGIC = "cosmosgl-events";
+static const int EVENT_LOG_VERSION = 1;
+
+EventRecorder::~EventRecorder() {
+    if (out) fclose(out);
+}
+
+bool EventRecorder::open(const char* path, double dt) {
+    out = fopen(path, "w");
+    if (!out) {
+        cerr << "Could not write event log: " << path << endl;
+        return false;
+    }
+    fprintf(out, "%s %d\ndt %.17g\n", EVENT_LOG_MAGIC, EVENT_LOG_VERSION, dt);
+    return true;
+}
+
+void EventRecorder::settings(const PhysicsEngine& physics) {
+    fprintf(out, "set gravConst %.17g\n", physics.gravConst);
+    fprintf(out, "set minDistance %.17g\n", physics.minDistance);
+    fprintf(out, "set integrator %d\n", (int)physics.integrator);
+    fprintf(out, "set softening %d\n", (int)physics.softening);
+    fprintf(out, "set softeningLength %.17g\n", physics.softeningLength);
+    fprintf(out, "set regularizationRadius %.17g\n", physics.regularizationRadius);
+    fprintf(out, "set collisions %d\n", physics.collisions ? 1 : 0);
+    fprintf(out, "set reorderInterval %zu\n", physics.reorderInterval);
+}
+
+void EventRecorder::event(uint64_t step, const char* name, double value) {
+    fprintf(out, "event %" PRIu64 " %s %.17g\n", step, name, value);
+}
+
+void EventRecorder::hash(uint64_t step, uint64_t hash) {
+    fprintf(out, "hash %" PRIu64 " %016" PRIx64 "\n", step, hash);
+    fflush(out); // a crashed run still leaves everything up to its last hash
+    lastHashed = step;
+}
+
+bool EventReplay::open(const char* path) {
+    ifstream in(path);
+    if (!in) {
+        cerr << "Could not open event log: " << path << endl;
+        return false;
+    }
+
+    string line, magic;
+    int version = 0;
+    if (!getline(in, line) || !(istringstream(line) >> magic >> version) || magic != EVENT_LOG_MAGIC) {
+        cerr << "Not an event log: " << path << endl;
+        return false;
+    }
+    if (version != EVENT_LOG_VERSION) {
+        cerr << "Unsupported event log version " << version << ": " << path << endl;
+        return false;
+    }
+
+    while (getline(in, line)) {
+        istringstream fields(line);
+        string kind;
+        if (!(fields >> kind) || kind[0] == '#') continue;
+
+        bool ok = true;
+        if (kind == "dt") {
+            ok = (bool)(fields >> dt);
+        } else if (kind == "set") {
+            pair<string, double> s;
+            ok = (bool)(fields >> s.first >> s.second);
+            if (ok) settingsList.push_back(s);
+        } else if (kind == "event") {
+            SimEvent e;
+            ok = (bool)(fields >> e.step >> e.name >> e.value);
+            if (ok) events.push_back(e);
+        } else if (kind == "hash") {
+            uint64_t step;
+            string hex;
+            ok = (bool)(fields >> step >> hex);
+            if (ok) hashes.push_back({ step, strtoull(hex.c_str(), nullptr, 16) });
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            cerr << "Malformed event log line: " << line << endl;
+            return false;
+        }
+    }
+    if (dt <= 0.0) {
+        cerr << "Event log has no fixed step: " << path << endl;
+        return false;
+    }
+    return true;
+}
+
+bool EventReplay::applySettings(PhysicsEngine& physics) const {
+    for (const auto& [key, value] : settingsList) {
+        if (key == "gravConst") physics.gravConst = value;
+        else if (key == "minDistance") physics.minDistance = value;
+        else if (key == "integrator") physics.integrator = (Integrator)(int)value;
+        else if (key == "softening") physics.softening = (Softening)(int)value;
+        else if (key == "softeningLength") physics.softeningLength = value;
+        else if (key == "regularizationRadius") physics.regularizationRadius = value;
+        else if (key == "collisions") physics.collisions = value != 0.0;
+        else if (key == "reorderInterval") physics.reorderInterval = (size_t)value;
+        else {
+            cerr << "Unknown setting in event log: " << key << endl;
+            return false;
+        }
+    }
+    // Replays are checked against, and events applied to, bodies at their recorded indices
+    if (physics.reorderInterval > 0) {
+        cerr << "Event log sets reorderInterval; replays need bodies to keep their indices" << endl;
+        return false;
+    }
+    return true;
+}
+
+bool EventReplay::verify(uint64_t step, uint64_t hash) {
+    while (nextHash < hashes.size() && hashes[nextHash].first < step) ++nextHash;
+    if (nextHash == hashes.size() || hashes[nextHash].first != step) return true;
+    uint64_t expected = hashes[nextHash++].second;
+    if (expected == hash) return true;
+    if (failed++ == 0) {
+        char buf[128];
+        snprintf(buf, sizeof(buf), "Replay diverged at step %" PRIu64 ": expected %016" PRIx64 ", got %016" PRIx64,
+                 step, expected, hash);
+        cerr << buf << endl;
+    }
+    return false;
+}
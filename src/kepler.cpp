@@ -0,0 +1,71 @@
+#include "kepler.h"
+
+#include <cmath>
+
+// Stumpff functions c2(z) and c3(z), with series near z = 0 where the closed forms cancel
+static void stumpff(double z, double& c2, double& c3) {
+    if (z > 1e-6) {
+        double s = std::sqrt(z);
+        c2 = (1.0 - std::cos(s)) / z;
+        c3 = (s - std::sin(s)) / (z * s);
+    } else if (z < -1e-6) {
+        double s = std::sqrt(-z);
+        c2 = (std::cosh(s) - 1.0) / -z;
+        c3 = (std::sinh(s) - s) / (-z * s);
+    } else {
+        c2 = 1.0 / 2.0 - z / 24.0 + z * z / 720.0;
+        c3 = 1.0 / 6.0 - z / 120.0 + z * z / 5040.0;
+    }
+}
+
+bool keplerDrift(double mu, double r[3], double v[3], double dt) {
+    if (mu <= 0.0 || dt == 0.0) return mu > 0.0;
+
+    const double r0 = std::sqrt(r[0] * r[0] + r[1] * r[1] + r[2] * r[2]);
+    if (r0 == 0.0) return false;
+    const double v02 = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+    const double sqrtMu = std::sqrt(mu);
+    const double sigma0 = (r[0] * v[0] + r[1] * v[1] + r[2] * v[2]) / sqrtMu; // r·v / √μ
+    const double alpha = 2.0 / r0 - v02 / mu;                                 // 1 / semi-major axis
+
+    // Whole periods of a bound orbit change nothing; dropping them keeps χ small
+    if (alpha > 0.0) {
+        double period = 2.0 * M_PI / (sqrtMu * alpha * std::sqrt(alpha));
+        dt = std::fmod(dt, period);
+    }
+
+    double chi = alpha > 0.0 ? sqrtMu * dt * alpha : sqrtMu * dt / r0;
+    double c2 = 0.5, c3 = 1.0 / 6.0, rn = r0;
+    bool converged = false;
+    for (int iter = 0; iter < 50 && !converged; ++iter) {
+        double chi2 = chi * chi;
+        stumpff(alpha * chi2, c2, c3);
+        double F = sigma0 * chi2 * c2 + (1.0 - alpha * r0) * chi2 * chi * c3 + r0 * chi - sqrtMu * dt;
+        rn = sigma0 * chi * (1.0 - alpha * chi2 * c3) + (1.0 - alpha * r0) * chi2 * c2 + r0; // dF/dχ
+        double F2 = sigma0 * (1.0 - alpha * chi2 * c2) + (1.0 - alpha * r0) * chi * (1.0 - alpha * chi2 * c3);
+
+        const double n = 5.0;
+        double root = std::sqrt(std::fabs((n - 1.0) * (n - 1.0) * rn * rn - n * (n - 1.0) * F * F2));
+        double delta = n * F / (rn + (rn >= 0.0 ? root : -root));
+        chi -= delta;
+        converged = std::fabs(delta) <= 1e-13 * std::fmax(std::fabs(chi), 1e-300);
+    }
+    if (!converged || !std::isfinite(chi)) return false;
+
+    // Lagrange coefficients at the converged χ
+    double chi2 = chi * chi;
+    stumpff(alpha * chi2, c2, c3);
+    double f = 1.0 - chi2 * c2 / r0;
+    double g = dt - chi2 * chi * c3 / sqrtMu;
+    double rNew[3] = { f * r[0] + g * v[0], f * r[1] + g * v[1], f * r[2] + g * v[2] };
+    rn = std::sqrt(rNew[0] * rNew[0] + rNew[1] * rNew[1] + rNew[2] * rNew[2]);
+    double fdot = sqrtMu / (rn * r0) * chi * (alpha * chi2 * c3 - 1.0);
+    double gdot = 1.0 - chi2 * c2 / rn;
+
+    for (int k = 0; k < 3; ++k) {
+        double vk = fdot * r[k] + gdot * v[k];
+        r[k] = rNew[k];
+        v[k] = vk;
+    }
+    return true;
+}
@@ -0,0 +1,123 @@
+#include "mortonOrder.h"
+#include "physicsEngine.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <omp.h>
+
+// Spreads the low 21 bits of v two zero bits apart
+static uint64_t spreadBits(uint64_t v) {
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffffull;
+    v = (v | v << 16) & 0x1f0000ff0000ffull;
+    v = (v | v << 8)  & 0x100f00f00f00f00full;
+    v = (v | v << 4)  & 0x10c30c30c30c30c3ull;
+    v = (v | v << 2)  & 0x1249249249249249ull;
+    return v;
+}
+
+uint64_t mortonKey(uint32_t x, uint32_t y, uint32_t z) {
+    return spreadBits(x) | spreadBits(y) << 1 | spreadBits(z) << 2;
+}
+
+void MortonSorter::radixSort(std::vector<uint64_t>& k, std::vector<uint32_t>& v) {
+    const size_t n = k.size();
+    uint64_t bits = 0;
+    for (size_t i = 0; i < n; ++i) bits |= k[i];
+    int passes = 0;
+    while (passes < 8 && (bits >> (8 * passes)) != 0) ++passes;
+
+    keysTmp.resize(n);
+    valuesTmp.resize(n);
+    histogram.resize(size_t(omp_get_max_threads()) * 256);
+    for (int pass = 0; pass < passes; ++pass) {
+        const int shift = 8 * pass;
+        std::fill(histogram.begin(), histogram.end(), 0);
+
+        // Thread t counts and then scatters its own contiguous block; every digit's slots are
+        // handed out thread by thread, which keeps the sort stable
+        #pragma omp parallel if (n > 16384)
+        {
+            const size_t t = omp_get_thread_num(), threads = omp_get_num_threads();
+            const size_t begin = n * t / threads, end = n * (t + 1) / threads;
+            size_t* h = histogram.data() + t * 256;
+            for (size_t i = begin; i < end; ++i) ++h[(k[i] >> shift) & 255];
+
+            #pragma omp barrier
+            #pragma omp single
+            {
+                size_t offset = 0;
+                for (size_t d = 0; d < 256; ++d) {
+                    for (size_t u = 0; u < threads; ++u) {
+                        size_t count = histogram[u * 256 + d];
+                        histogram[u * 256 + d] = offset;
+                        offset += count;
+                    }
+                }
+            }
+            for (size_t i = begin; i < end; ++i) {
+                size_t dst = h[(k[i] >> shift) & 255]++;
+                keysTmp[dst] = k[i];
+                valuesTmp[dst] = v[i];
+            }
+        }
+        k.swap(keysTmp);
+        v.swap(valuesTmp);
+    }
+}
+
+void MortonSorter::order(const Bodies& bodies, std::vector<uint32_t>& out) {
+    PROFILE_ZONE("morton sort");
+    const size_t n = bodies.size();
+    out.clear();
+    if (n == 0) return;
+
+    // Keys for top-level bodies only, inside the cube around them
+    roots.clear();
+    double lo[3] = { 0.0, 0.0, 0.0 }, hi[3] = { 0.0, 0.0, 0.0 };
+    for (size_t i = 0; i < n; ++i) {
+        if (bodies.parent[i] >= 0) continue;
+        double p[3] = { bodies.x[i], bodies.y[i], bodies.z[i] };
+        for (int a = 0; a < 3; ++a) {
+            lo[a] = roots.empty() ? p[a] : std::min(lo[a], p[a]);
+            hi[a] = roots.empty() ? p[a] : std::max(hi[a], p[a]);
+        }
+        roots.push_back((uint32_t)i);
+    }
+    const double extent = std::max({ hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2] });
+    const double top = double((1u << 21) - 1);
+    const double scale = extent > 0.0 ? top / extent : 0.0;
+
+    const long m = (long)roots.size();
+    keys.resize(m);
+    #pragma omp parallel for schedule(static) if (m > 16384)
+    for (long k = 0; k < m; ++k) {
+        const uint32_t i = roots[k];
+        const double p[3] = { bodies.x[i], bodies.y[i], bodies.z[i] };
+        uint32_t q[3];
+        for (int a = 0; a < 3; ++a) {
+            double f = (p[a] - lo[a]) * scale; // NaN lands at 0
+            q[a] = (uint32_t)(f > 0.0 ? std::min(f, top) : 0.0);
+        }
+        keys[k] = mortonKey(q[0], q[1], q[2]);
+    }
+    radixSort(keys, roots);
+
+    // Each group's members in index order, which starts with the top-level body itself
+    root.resize(n);
+    groupStart.assign(n + 1, 0);
+    for (size_t i = 0; i < n; ++i) {
+        root[i] = bodies.parent[i] < 0 ? (uint32_t)i : root[bodies.parent[i]];
+        ++groupStart[root[i] + 1];
+    }
+    for (size_t r = 0; r < n; ++r) groupStart[r + 1] += groupStart[r];
+    members.resize(n);
+    for (size_t i = 0; i < n; ++i) members[groupStart[root[i]]++] = (uint32_t)i;
+
+    // The fill above advanced every start to the next group's, so group r now ends at groupStart[r]
+    out.reserve(n);
+    for (uint32_t r : roots) {
+        const uint32_t begin = r == 0 ? 0 : groupStart[r - 1];
+        out.insert(out.end(), members.begin() + begin, members.begin() + groupStart[r]);
+    }
+}
@@ -0,0 +1,727 @@
+#include "physicsEngine.h"
+#include "collisions.h"
+#include "kepler.h"
+#include "mortonOrder.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <iostream>
+
+void Bodies::reserve(size_t n) {
+    for (auto* v : { &x, &y, &z, &vx, &vy, &vz, &ax, &ay, &az, &mass, &radius }) v->reserve(n);
+    parent.reserve(n);
+    merged.reserve(n);
+    slot.reserve(n);
+}
+
+void Bodies::resize(size_t n) {
+    for (uint32_t s = 0; s < slots.index.size(); ++s) {
+        if (slots.index[s] != UINT32_MAX && slots.index[s] >= n) releaseSlot(s);
+    }
+    for (auto* v : { &x, &y, &z, &vx, &vy, &vz, &ax, &ay, &az, &mass, &radius }) v->resize(n, 0.0);
+    parent.resize(n, -1);
+    merged.resize(n, 0);
+    size_t old = slot.size();
+    slot.resize(n);
+    for (size_t i = old; i < n; ++i) slot[i] = acquireSlot((uint32_t)i);
+}
+
+void Bodies::clear() {
+    resize(0);
+}
+
+size_t Bodies::add(double px, double py, double pz, double velX, double velY, double velZ, double m, double r, int parentIndex) {
+    x.push_back(px); y.push_back(py); z.push_back(pz);
+    vx.push_back(velX); vy.push_back(velY); vz.push_back(velZ);
+    ax.push_back(0.0); ay.push_back(0.0); az.push_back(0.0);
+    mass.push_back(m);
+    radius.push_back(r);
+    parent.push_back(parentIndex);
+    merged.push_back(0);
+    slot.push_back(acquireSlot((uint32_t)(x.size() - 1)));
+    return x.size() - 1;
+}
+
+// Freed slots are reused most recent first; the bumped generation keeps old handles stale
+uint32_t Bodies::acquireSlot(uint32_t index) {
+    uint32_t s;
+    if (!slots.freeSlots.empty()) {
+        s = slots.freeSlots.back();
+        slots.freeSlots.pop_back();
+    } else {
+        s = (uint32_t)slots.index.size();
+        slots.index.push_back(UINT32_MAX);
+        slots.generation.push_back(0);
+    }
+    slots.index[s] = index;
+    return s;
+}
+
+void Bodies::releaseSlot(uint32_t s) {
+    slots.index[s] = UINT32_MAX;
+    ++slots.generation[s];
+    slots.freeSlots.push_back(s);
+}
+
+void Bodies::permute(const std::vector<uint32_t>& order) {
+    const size_t n = size(), m = order.size();
+
+    // New index of every old body; an absorbed body left out maps to its absorber's, parents first
+    std::vector<uint32_t> to(n, UINT32_MAX);
+    for (size_t k = 0; k < m; ++k) to[order[k]] = (uint32_t)k;
+    for (size_t i = 0; i < n; ++i) {
+        if (to[i] == UINT32_MAX && absorbed(i)) to[i] = to[parent[i]];
+    }
+
+    std::vector<double> scratch(m);
+    for (auto* v : { &x, &y, &z, &vx, &vy, &vz, &ax, &ay, &az, &mass, &radius }) {
+        for (size_t k = 0; k < m; ++k) scratch[k] = (*v)[order[k]];
+        v->swap(scratch);
+        scratch.resize(m);
+    }
+    std::vector<int> parents(m);
+    for (size_t k = 0; k < m; ++k) {
+        int p = parent[order[k]];
+        parents[k] = p < 0 || to[p] == UINT32_MAX ? -1 : (int)to[p];
+    }
+    parent.swap(parents);
+    std::vector<uint8_t> flags(m);
+    for (size_t k = 0; k < m; ++k) flags[k] = merged[order[k]];
+    merged.swap(flags);
+
+    // Every live slot, including ones already aliased by an earlier compaction, follows its body;
+    // removed bodies' slots are freed unless they were absorbed
+    for (uint32_t s = 0; s < slots.index.size(); ++s) {
+        uint32_t i = slots.index[s];
+        if (i == UINT32_MAX) continue;
+        if (to[i] == UINT32_MAX) releaseSlot(s);
+        else slots.index[s] = to[i];
+    }
+    std::vector<uint32_t> slotOf(m);
+    for (size_t k = 0; k < m; ++k) slotOf[k] = slot[order[k]];
+    slot.swap(slotOf);
+}
+
+LogChannel::LogChannel(std::ostream& stream, size_t threshold)
+    : out(stream), flushThreshold(threshold) {
+    buffer.reserve(threshold + 256);
+}
+
+LogChannel::~LogChannel() {
+    flush();
+}
+
+void LogChannel::print(const char* fmt, ...) {
+    char line[256];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if (len <= 0) return;
+
+    buffer.append(line, std::min<size_t>(len, sizeof(line) - 1));
+    if (buffer.size() >= flushThreshold) flush();
+}
+
+void LogChannel::flush() {
+    if (buffer.empty()) return;
+    out.write(buffer.data(), (std::streamsize)buffer.size());
+    out.flush();
+    buffer.clear();
+}
+
+// Pair force per unit G·m_j·dx at squared separation r2. Each softening is its own
+// specialization, so the kernel below carries no per-pair branching on the kind.
+template <Softening S>
+static inline double pairFactor(double r2, double minDist2, double eps);
+
+// Newtonian; the self term (r2 == 0) and pairs inside minDistance are masked out
+template <>
+inline double pairFactor<Softening::None>(double r2, double minDist2, double) {
+    return (r2 > minDist2 && r2 > 0.0) ? 1.0 / (r2 * std::sqrt(r2)) : 0.0;
+}
+
+template <>
+inline double pairFactor<Softening::Plummer>(double r2, double, double eps) {
+    double d2 = r2 + eps * eps;
+    return 1.0 / (d2 * std::sqrt(d2));
+}
+
+// Monaghan cubic-spline kernel with support h = 2.8 ε: Newtonian beyond h, finite at r = 0
+template <>
+inline double pairFactor<Softening::Spline>(double r2, double, double eps) {
+    const double h = 2.8 * eps;
+    double r = std::sqrt(r2), u = r / h;
+    double hInv3 = 1.0 / (h * h * h);
+    double inner = hInv3 * (32.0 / 3.0 + u * u * (32.0 * u - 38.4));
+    double outer = hInv3 * (64.0 / 3.0 - 48.0 * u + 38.4 * u * u - 32.0 / 3.0 * u * u * u - 1.0 / 15.0 / (u * u * u));
+    return u < 0.5 ? inner : (u < 1.0 ? outer : 1.0 / (r2 * r));
+}
+
+// Pair potential per unit G·m_j (positive; the energy is -G m_i m_j φ), from the force factor f the
+// kernel already has for the pair: 1/r = f r² when f = 1/r³, and the same for Plummer with r² + ε².
+template <Softening S>
+static inline double pairPotential(double r2, double f, double eps);
+
+template <>
+inline double pairPotential<Softening::None>(double r2, double f, double) {
+    return f * r2;
+}
+
+template <>
+inline double pairPotential<Softening::Plummer>(double r2, double f, double eps) {
+    return f * (r2 + eps * eps);
+}
+
+// Integral of the spline force above (Springel 2005); equals 1/r from u = 1 outwards
+template <>
+inline double pairPotential<Softening::Spline>(double r2, double f, double eps) {
+    const double h = 2.8 * eps;
+    double u = std::sqrt(r2) / h;
+    double inner = 2.8 - u * u * (16.0 / 3.0 + u * u * (6.4 * u - 9.6));
+    double outer = 3.2 - 1.0 / 15.0 / u - u * u * (32.0 / 3.0 + u * (-16.0 + u * (9.6 - 32.0 / 15.0 * u)));
+    return u < 0.5 ? inner / h : (u < 1.0 ? outer / h : f * r2);
+}
+
+void PhysicsEngine::updateSources() {
+    const long n = (long)bodies.size();
+
+    // Children never act as sources; rebuilt only when the body set changes size
+    if (sourceMass.size() != (size_t)n) {
+        sourceMass.resize(n);
+        children.clear();
+        for (long i = 0; i < n; ++i) {
+            if (bodies.parent[i] >= 0) children.push_back((int)i);
+        }
+    }
+    for (long i = 0; i < n; ++i) {
+        sourceMass[i] = bodies.parent[i] < 0 ? bodies.mass[i] : 0.0;
+    }
+
+    // Wisdom–Holman kicks carry only the interactions; the central pull is in the Kepler drift
+    if (integrator == Integrator::WisdomHolman) {
+        central = n > 0 ? (int)(std::max_element(sourceMass.begin(), sourceMass.end()) - sourceMass.begin()) : -1;
+        if (central >= 0) sourceMass[central] = 0.0;
+    }
+}
+
+void PhysicsEngine::computeAccelerations() {
+    PROFILE_ZONE("forces");
+    if (beforeForces) beforeForces();
+    updateSources();
+
+    if (regularizationRadius > 0.0 && integrator != Integrator::WisdomHolman) findBinaries();
+    else binaries.clear();
+
+    // Softening needs a length; without one every kind reduces to Newtonian
+    switch (softeningLength > 0.0 ? softening : Softening::None) {
+    case Softening::None:    diagnostics ? forceKernel<Softening::None, true>()    : forceKernel<Softening::None, false>();    break;
+    case Softening::Plummer: diagnostics ? forceKernel<Softening::Plummer, true>() : forceKernel<Softening::Plummer, false>(); break;
+    case Softening::Spline:  diagnostics ? forceKernel<Softening::Spline, true>()  : forceKernel<Softening::Spline, false>();  break;
+    }
+    accelerationsValid = true;
+
+    // Every pair was visited from both ends; summed in index order so the result is reproducible
+    if (diagnostics) {
+        double sum = 0.0;
+        for (size_t i = 0; i < bodies.size(); ++i) {
+            if (bodies.parent[i] < 0) sum += bodies.mass[i] * potential[i];
+        }
+        metrics.potential = -0.5 * gravConst * sum;
+        measureMotion();
+    }
+}
+
+// Kinetic energy, momentum and angular momentum for the positions the potential was measured at
+void PhysicsEngine::measureMotion() {
+    const Bodies& b = bodies;
+    double kinetic = 0.0, p[3] = { 0.0, 0.0, 0.0 }, L[3] = { 0.0, 0.0, 0.0 };
+    for (size_t i = 0; i < b.size(); ++i) {
+        if (b.parent[i] >= 0) continue;
+        const double m = b.mass[i];
+        kinetic += 0.5 * m * (b.vx[i] * b.vx[i] + b.vy[i] * b.vy[i] + b.vz[i] * b.vz[i]);
+        p[0] += m * b.vx[i];
+        p[1] += m * b.vy[i];
+        p[2] += m * b.vz[i];
+        L[0] += m * (b.y[i] * b.vz[i] - b.z[i] * b.vy[i]);
+        L[1] += m * (b.z[i] * b.vx[i] - b.x[i] * b.vz[i]);
+        L[2] += m * (b.x[i] * b.vy[i] - b.y[i] * b.vx[i]);
+    }
+    metrics.time = time;
+    metrics.kinetic = kinetic;
+    for (int a = 0; a < 3; ++a) {
+        metrics.momentum[a] = p[a];
+        metrics.angularMomentum[a] = L[a];
+    }
+}
+
+template <Softening S, bool Potential>
+void PhysicsEngine::forceKernel() {
+    const long n = (long)bodies.size();
+    const double* x = bodies.x.data();
+    const double* y = bodies.y.data();
+    const double* z = bodies.z.data();
+    const double* m = sourceMass.data();
+    const int* parent = bodies.parent.data();
+    double* ax = bodies.ax.data();
+    double* ay = bodies.ay.data();
+    double* az = bodies.az.data();
+    const double Gc = gravConst;
+    const double minDist2 = minDistance * minDistance;
+    const double eps = softeningLength;
+    const long g = (long)ghostMass.size();
+    const double* gx = ghostX.data();
+    const double* gy = ghostY.data();
+    const double* gz = ghostZ.data();
+    const double* gm = ghostMass.data();
+    if (Potential) potential.resize(n);
+    double* pot = potential.data();
+    const int c = integrator == Integrator::WisdomHolman ? central : -1;
+
+    #pragma omp parallel for schedule(static)
+    for (long i = 0; i < n; ++i) {
+        if (parent[i] >= 0) continue;
+        const double xi = x[i], yi = y[i], zi = z[i];
+        double axi = 0.0, ayi = 0.0, azi = 0.0, poti = 0.0;
+
+        #pragma omp simd reduction(+:axi,ayi,azi,poti)
+        for (long j = 0; j < n; ++j) {
+            double dx = x[j] - xi;
+            double dy = y[j] - yi;
+            double dz = z[j] - zi;
+            double r2 = dx * dx + dy * dy + dz * dz;
+            double f = pairFactor<S>(r2, minDist2, eps);
+            double s = Gc * m[j] * f;
+            axi += dx * s;
+            ayi += dy * s;
+            azi += dz * s;
+            // Softened kernels are finite at r = 0, so the self term has to be masked here
+            if constexpr (Potential) poti += j != i ? m[j] * pairPotential<S>(r2, f, eps) : 0.0;
+        }
+
+        if constexpr (Potential) {
+            // Wisdom–Holman leaves the central body out of the sources, but its pairs are still energy
+            if (c >= 0 && i != c) {
+                double dx = x[c] - xi, dy = y[c] - yi, dz = z[c] - zi;
+                double r2 = dx * dx + dy * dy + dz * dz;
+                poti += bodies.mass[c] * pairPotential<S>(r2, pairFactor<S>(r2, minDist2, eps), eps);
+            }
+            pot[i] = poti;
+        }
+
+        #pragma omp simd reduction(+:axi,ayi,azi)
+        for (long j = 0; j < g; ++j) {
+            double dx = gx[j] - xi;
+            double dy = gy[j] - yi;
+            double dz = gz[j] - zi;
+            double r2 = dx * dx + dy * dy + dz * dz;
+            double s = Gc * gm[j] * pairFactor<S>(r2, minDist2, eps);
+            axi += dx * s;
+            ayi += dy * s;
+            azi += dz * s;
+        }
+
+        ax[i] = axi;
+        ay[i] = ayi;
+        az[i] = azi;
+    }
+
+    // Children ride along with their parent and add its pull; parents come first in index order
+    for (int i : children) {
+        int p = parent[i];
+        double dx = x[p] - x[i];
+        double dy = y[p] - y[i];
+        double dz = z[p] - z[i];
+        double r2 = dx * dx + dy * dy + dz * dz;
+        double s = Gc * bodies.mass[p] * pairFactor<S>(r2, minDist2, eps);
+        ax[i] = ax[p] + dx * s;
+        ay[i] = ay[p] + dy * s;
+        az[i] = az[p] + dz * s;
+    }
+
+    // A regularized pair's mutual pull is integrated exactly in drift(), so take it back out.
+    // Children above already followed their parent's full acceleration, as they should.
+    for (const auto& [i, j] : binaries) {
+        double dx = x[j] - x[i];
+        double dy = y[j] - y[i];
+        double dz = z[j] - z[i];
+        double f = Gc * pairFactor<S>(dx * dx + dy * dy + dz * dz, minDist2, eps);
+        ax[i] -= dx * f * m[j]; ay[i] -= dy * f * m[j]; az[i] -= dz * f * m[j];
+        ax[j] += dx * f * m[i]; ay[j] += dy * f * m[i]; az[j] += dz * f * m[i];
+    }
+}
+
+// Pairs of top-level bodies that are each other's nearest neighbour within regularizationRadius
+void PhysicsEngine::findBinaries() {
+    const long n = (long)bodies.size();
+    const double* x = bodies.x.data();
+    const double* y = bodies.y.data();
+    const double* z = bodies.z.data();
+    const double* m = sourceMass.data();
+    const double radius2 = regularizationRadius * regularizationRadius;
+    nearest.assign(n, -1);
+
+    #pragma omp parallel for schedule(static)
+    for (long i = 0; i < n; ++i) {
+        if (m[i] <= 0.0) continue;
+        double best = radius2;
+        for (long j = 0; j < n; ++j) {
+            if (j == i || m[j] <= 0.0) continue;
+            double dx = x[j] - x[i], dy = y[j] - y[i], dz = z[j] - z[i];
+            double r2 = dx * dx + dy * dy + dz * dz;
+            if (r2 < best) {
+                best = r2;
+                nearest[i] = (int)j;
+            }
+        }
+    }
+
+    binaries.clear();
+    for (long i = 0; i < n; ++i) {
+        int j = nearest[i];
+        if (j > i && nearest[j] == i) binaries.push_back({ (int)i, j });
+    }
+}
+
+void PhysicsEngine::kick(double dt) {
+    const long n = (long)bodies.size();
+    double* vx = bodies.vx.data();
+    double* vy = bodies.vy.data();
+    double* vz = bodies.vz.data();
+    const double* ax = bodies.ax.data();
+    const double* ay = bodies.ay.data();
+    const double* az = bodies.az.data();
+
+    #pragma omp parallel for simd schedule(static)
+    for (long i = 0; i < n; ++i) {
+        vx[i] += ax[i] * dt;
+        vy[i] += ay[i] * dt;
+        vz[i] += az[i] * dt;
+    }
+}
+
+// keplerDrift that always advances: a solve that does not converge is retried in shorter pieces,
+// and any piece that still fails drifts in a straight line. Returns false if a piece had to.
+static bool twoBodyDrift(double mu, double r[3], double v[3], double dt) {
+    if (keplerDrift(mu, r, v, dt)) return true;
+    const int pieces = 16;
+    const double h = dt / pieces;
+    bool solved = true;
+    for (int k = 0; k < pieces; ++k) {
+        if (keplerDrift(mu, r, v, h)) continue;
+        r[0] += v[0] * h; r[1] += v[1] * h; r[2] += v[2] * h;
+        solved = false;
+    }
+    return solved;
+}
+
+void PhysicsEngine::countKeplerFailures(size_t failures) {
+    if (failures == 0) return;
+    if (keplerFailures == 0) {
+        std::cerr << "Physics: Kepler solve did not converge at t = " << time
+                  << " s; drifting in a straight line instead (counted in keplerFailures)" << std::endl;
+    }
+    keplerFailures += failures;
+}
+
+void PhysicsEngine::drift(double dt) {
+    const long n = (long)bodies.size();
+    double* x = bodies.x.data();
+    double* y = bodies.y.data();
+    double* z = bodies.z.data();
+    const double* vx = bodies.vx.data();
+    const double* vy = bodies.vy.data();
+    const double* vz = bodies.vz.data();
+
+    #pragma omp parallel for simd schedule(static)
+    for (long i = 0; i < n; ++i) {
+        x[i] += vx[i] * dt;
+        y[i] += vy[i] * dt;
+        z[i] += vz[i] * dt;
+    }
+
+    // Regularized pairs: the centre of mass drifts, the separation follows its Kepler orbit.
+    // Velocities were not touched above, so the start-of-drift positions are recoverable.
+    size_t failures = 0;
+    for (const auto& [i, j] : binaries) {
+        double mi = bodies.mass[i], mj = bodies.mass[j], M = mi + mj;
+        double r[3] = { (x[j] - vx[j] * dt) - (x[i] - vx[i] * dt),
+                        (y[j] - vy[j] * dt) - (y[i] - vy[i] * dt),
+                        (z[j] - vz[j] * dt) - (z[i] - vz[i] * dt) };
+        double v[3] = { vx[j] - vx[i], vy[j] - vy[i], vz[j] - vz[i] };
+        if (!twoBodyDrift(gravConst * M, r, v, dt)) ++failures;
+
+        double cx = (mi * x[i] + mj * x[j]) / M, cy = (mi * y[i] + mj * y[j]) / M, cz = (mi * z[i] + mj * z[j]) / M;
+        double cvx = (mi * vx[i] + mj * vx[j]) / M, cvy = (mi * vy[i] + mj * vy[j]) / M, cvz = (mi * vz[i] + mj * vz[j]) / M;
+        double wi = mj / M, wj = mi / M;
+        x[i] = cx - wi * r[0]; y[i] = cy - wi * r[1]; z[i] = cz - wi * r[2];
+        x[j] = cx + wj * r[0]; y[j] = cy + wj * r[1]; z[j] = cz + wj * r[2];
+        bodies.vx[i] = cvx - wi * v[0]; bodies.vy[i] = cvy - wi * v[1]; bodies.vz[i] = cvz - wi * v[2];
+        bodies.vx[j] = cvx + wj * v[0]; bodies.vy[j] = cvy + wj * v[1]; bodies.vz[j] = cvz + wj * v[2];
+    }
+    countKeplerFailures(failures);
+}
+
+PhysicsEngine::PhysicsEngine() : detector(std::make_unique<CollisionDetector>()), sorter(std::make_unique<MortonSorter>()) {}
+
+PhysicsEngine::~PhysicsEngine() = default;
+
+void PhysicsEngine::resolveCollisions() {
+    PROFILE_ZONE("collisions");
+    detector->find(bodies, startX.data(), startY.data(), startZ.data(), contacts);
+    if (contacts.empty()) return;
+
+    size_t merged = mergeCollisions(bodies, contacts);
+    if (merged == 0) return;
+    mergeCount += merged;
+    markBodiesChanged();
+    if (log) log->print("collisions: %zu merged at t = %g s\n", merged, time);
+}
+
+void PhysicsEngine::permute(const std::vector<uint32_t>& order) {
+    std::vector<int> to(bodies.size(), -1);
+    for (size_t k = 0; k < order.size(); ++k) to[order[k]] = (int)k;
+    bodies.permute(order);
+
+    // A regularized pair with a removed body falls back to the plain drift
+    size_t kept = 0;
+    for (const auto& [i, j] : binaries) {
+        int a = to[i], b = to[j];
+        if (a >= 0 && b >= 0) binaries[kept++] = { std::min(a, b), std::max(a, b) };
+    }
+    binaries.resize(kept);
+    sourceMass.clear();
+    updateSources();
+}
+
+size_t PhysicsEngine::compact() {
+    std::vector<uint32_t> order;
+    order.reserve(bodies.size());
+    for (size_t i = 0; i < bodies.size(); ++i) {
+        if (!bodies.absorbed(i)) order.push_back((uint32_t)i);
+    }
+    size_t removed = bodies.size() - order.size();
+    if (removed > 0) permute(order);
+    return removed;
+}
+
+void PhysicsEngine::sortBodies() {
+    sorter->order(bodies, sortOrder);
+    permute(sortOrder);
+    stepsSinceSort = 0;
+}
+
+// Democratic-heliocentric splitting (Duncan, Levison & Lee 1998): half interaction kick, half
+// solar-momentum jump, Kepler drift about the central body, half jump, half kick. Children move on
+// exact Kepler orbits about their parents, which is all the pull they feel.
+void PhysicsEngine::wisdomHolmanStep(double dt) {
+    if (!accelerationsValid || central < 0) computeAccelerations();
+    const long n = (long)bodies.size();
+    // Nothing to orbit: the interaction kicks are the whole force, so plain kick-drift-kick is exact
+    if (central < 0 || bodies.parent[central] >= 0 || bodies.mass[central] <= 0.0) {
+        kick(0.5 * dt);
+        drift(dt);
+        computeAccelerations();
+        kick(0.5 * dt);
+        return;
+    }
+    const int c = central;
+    const double mc = bodies.mass[c];
+    double* x = bodies.x.data();
+    double* y = bodies.y.data();
+    double* z = bodies.z.data();
+    double* vx = bodies.vx.data();
+    double* vy = bodies.vy.data();
+    double* vz = bodies.vz.data();
+    const double* m = sourceMass.data(); // 0 for children and for the central body
+    const int* parent = bodies.parent.data();
+
+    for (auto* v : { &relX, &relY, &relZ, &relVx, &relVy, &relVz }) v->resize(n);
+
+    // Barycentre of the top-level bodies, which moves in a straight line
+    double M = mc, cx = mc * x[c], cy = mc * y[c], cz = mc * z[c];
+    double cvx = mc * vx[c], cvy = mc * vy[c], cvz = mc * vz[c];
+    for (long i = 0; i < n; ++i) {
+        M += m[i];
+        cx += m[i] * x[i]; cy += m[i] * y[i]; cz += m[i] * z[i];
+        cvx += m[i] * vx[i]; cvy += m[i] * vy[i]; cvz += m[i] * vz[i];
+    }
+    cx /= M; cy /= M; cz /= M;
+    cvx /= M; cvy /= M; cvz /= M;
+
+    for (long i = 0; i < n; ++i) {
+        bool child = parent[i] >= 0;
+        long o = child ? parent[i] : c;
+        relX[i] = x[i] - x[o];
+        relY[i] = y[i] - y[o];
+        relZ[i] = z[i] - z[o];
+        relVx[i] = vx[i] - (child ? vx[o] : cvx);
+        relVy[i] = vy[i] - (child ? vy[o] : cvy);
+        relVz[i] = vz[i] - (child ? vz[o] : cvz);
+    }
+
+    auto interact = [&](double h) {
+        for (long i = 0; i < n; ++i) {
+            if (parent[i] >= 0 || i == c) continue;
+            relVx[i] += bodies.ax[i] * h;
+            relVy[i] += bodies.ay[i] * h;
+            relVz[i] += bodies.az[i] * h;
+        }
+    };
+    // The central body's recoil, shared by every heliocentric position
+    auto jump = [&](double h) {
+        double px = 0.0, py = 0.0, pz = 0.0;
+        for (long i = 0; i < n; ++i) {
+            px += m[i] * relVx[i]; py += m[i] * relVy[i]; pz += m[i] * relVz[i];
+        }
+        for (long i = 0; i < n; ++i) {
+            if (parent[i] >= 0 || i == c) continue;
+            relX[i] += px / mc * h;
+            relY[i] += py / mc * h;
+            relZ[i] += pz / mc * h;
+        }
+    };
+
+    interact(0.5 * dt);
+    jump(0.5 * dt);
+
+    // Every orbit is independent here
+    const double Gc = gravConst;
+    size_t failures = 0;
+    #pragma omp parallel for schedule(dynamic, 64) reduction(+ : failures)
+    for (long i = 0; i < n; ++i) {
+        if (i == c) continue;
+        double mu = Gc * (parent[i] >= 0 ? bodies.mass[parent[i]] : mc);
+        double r[3] = { relX[i], relY[i], relZ[i] };
+        double v[3] = { relVx[i], relVy[i], relVz[i] };
+        if (!twoBodyDrift(mu, r, v, dt)) ++failures;
+        relX[i] = r[0]; relY[i] = r[1]; relZ[i] = r[2];
+        relVx[i] = v[0]; relVy[i] = v[1]; relVz[i] = v[2];
+    }
+
+    countKeplerFailures(failures);
+    jump(0.5 * dt);
+
+    // Back to inertial positions for the closing force pass; parents precede their children
+    cx += cvx * dt; cy += cvy * dt; cz += cvz * dt;
+    double sx = 0.0, sy = 0.0, sz = 0.0;
+    for (long i = 0; i < n; ++i) {
+        sx += m[i] * relX[i]; sy += m[i] * relY[i]; sz += m[i] * relZ[i];
+    }
+    x[c] = cx - sx / M; y[c] = cy - sy / M; z[c] = cz - sz / M;
+    for (long i = 0; i < n; ++i) {
+        if (i == c) continue;
+        long o = parent[i] >= 0 ? parent[i] : c;
+        x[i] = x[o] + relX[i];
+        y[i] = y[o] + relY[i];
+        z[i] = z[o] + relZ[i];
+    }
+
+    computeAccelerations();
+    interact(0.5 * dt);
+
+    double px = 0.0, py = 0.0, pz = 0.0;
+    for (long i = 0; i < n; ++i) {
+        px += m[i] * relVx[i]; py += m[i] * relVy[i]; pz += m[i] * relVz[i];
+    }
+    vx[c] = cvx - px / mc; vy[c] = cvy - py / mc; vz[c] = cvz - pz / mc;
+    for (long i = 0; i < n; ++i) {
+        if (i == c) continue;
+        bool child = parent[i] >= 0;
+        vx[i] = relVx[i] + (child ? vx[parent[i]] : cvx);
+        vy[i] = relVy[i] + (child ? vy[parent[i]] : cvy);
+        vz[i] = relVz[i] + (child ? vz[parent[i]] : cvz);
+    }
+}
+
+static uint64_t fnv1a(const void* data, size_t size, uint64_t hash) {
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i < size; ++i) hash = (hash ^ p[i]) * 1099511628211ull;
+    return hash;
+}
+
+uint64_t PhysicsEngine::stateHash() const {
+    uint64_t hash = fnv1a(&time, sizeof(time), 14695981039346656037ull);
+    for (const auto* v : { &bodies.x, &bodies.y, &bodies.z, &bodies.vx, &bodies.vy, &bodies.vz, &bodies.mass, &bodies.radius }) {
+        hash = fnv1a(v->data(), v->size() * sizeof(double), hash);
+    }
+    hash = fnv1a(bodies.parent.data(), bodies.parent.size() * sizeof(int), hash);
+    for (const auto* v : { &particles.x, &particles.y, &particles.z, &particles.vx, &particles.vy, &particles.vz }) {
+        hash = fnv1a(v->data(), v->size() * sizeof(double), hash);
+    }
+    return hash;
+}
+
+// Children pull on particles too: a moon sculpting a ring is what particle rings are for
+void PhysicsEngine::accelerateParticles() {
+    massiveX.clear();
+    massiveY.clear();
+    massiveZ.clear();
+    massiveGm.clear();
+    for (size_t i = 0; i < bodies.size(); ++i) {
+        if (bodies.mass[i] <= 0.0) continue;
+        massiveX.push_back(bodies.x[i]);
+        massiveY.push_back(bodies.y[i]);
+        massiveZ.push_back(bodies.z[i]);
+        massiveGm.push_back(gravConst * bodies.mass[i]);
+    }
+    particles.accelerate(massiveX.data(), massiveY.data(), massiveZ.data(), massiveGm.data(), massiveGm.size(), minDistance);
+}
+
+void PhysicsEngine::step(double dt) {
+    if (reorderInterval > 0 && ++stepsSinceSort >= reorderInterval) sortBodies();
+    if (collisions) {
+        startX.assign(bodies.x.begin(), bodies.x.end());
+        startY.assign(bodies.y.begin(), bodies.y.end());
+        startZ.assign(bodies.z.begin(), bodies.z.end());
+    }
+
+    // Particles kick-drift-kick against the bodies at the start and end of the step
+    if (!particles.empty()) {
+        if (!particles.accelerationsValid) accelerateParticles();
+        particles.kick(0.5 * dt);
+        particles.drift(dt);
+    }
+
+    switch (integrator) {
+    case Integrator::SemiImplicitEuler:
+        computeAccelerations();
+        kick(dt);
+        drift(dt);
+        break;
+    case Integrator::Leapfrog:
+        if (!accelerationsValid) computeAccelerations();
+        kick(0.5 * dt);
+        drift(dt);
+        computeAccelerations();
+        kick(0.5 * dt);
+        break;
+    case Integrator::WisdomHolman:
+        wisdomHolmanStep(dt);
+        break;
+    }
+    // Positions moved after the last force pass
+    if (integrator == Integrator::SemiImplicitEuler) accelerationsValid = false;
+    time += dt;
+    // The others end on a force pass at the new positions, so only the velocities need measuring again
+    if (diagnostics) {
+        if (integrator != Integrator::SemiImplicitEuler) measureMotion();
+        ++metrics.samples;
+    }
+
+    if (collisions) resolveCollisions();
+
+    if (!particles.empty()) {
+        accelerateParticles();
+        particles.kick(0.5 * dt);
+    }
+
+    if (log) {
+        for (size_t i = 0; i < bodies.size(); ++i) {
+            log->print("velocity: %g, %g, %g\n", bodies.vx[i], bodies.vy[i], bodies.vz[i]);
+        }
+    }
+}
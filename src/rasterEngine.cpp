@@ -1,5 +1,9 @@
 #include "rasterEngine.h"
 
+#include <chrono>
+#include <cstdio>
+#include <random>
+
 Star::Star(vec3 pos, double m, double r, vec3 c, double b, vec3 v) 
     : position(pos), mass(m), radius(r), color(c), brightness(b), initialVelocity(v) {
     
@@ -213,14 +217,30 @@ Engine::Engine() {
     glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(mat4), NULL, GL_DYNAMIC_DRAW);
     glBindBufferBase(GL_UNIFORM_BUFFER, 0, uboWindowData);
 
-    this->trailShaderID = createShader("resources/shaders/trail.vert", "resources/shaders/trail.frag");
-    this->starShaderID = createShader("resources/shaders/star.vert", "resources/shaders/star.frag");
-    this->planetShaderID = createShader("resources/shaders/planet.vert", "resources/shaders/planet.frag");
-    this->ringShaderID = createShader("resources/shaders/ring.vert", "resources/shaders/ring.frag");
-    this->satelliteShaderID = createShader("resources/shaders/satellite.vert", "resources/shaders/satellite.frag");
+    struct { GLuint* id; const char* vert; const char* frag; } programs[] = {
+        { &trailShaderID, "resources/shaders/trail.vert", "resources/shaders/trail.frag" },
+        { &starShaderID, "resources/shaders/star.vert", "resources/shaders/star.frag" },
+        { &planetShaderID, "resources/shaders/planet.vert", "resources/shaders/planet.frag" },
+        { &ringShaderID, "resources/shaders/ring.vert", "resources/shaders/ring.frag" },
+        { &satelliteShaderID, "resources/shaders/satellite.vert", "resources/shaders/satellite.frag" },
+        { &particleShaderID, "resources/shaders/particle.vert", "resources/shaders/particle.frag" },
+    };
+    for (const auto& p : programs) *p.id = createShader(p.vert, p.frag);
 
     glEnable(GL_DEPTH_TEST);
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+    physics.gravConst = G;
+    physics.minDistance = 1e5;
+    physics.collisions = true;
+
+    shaderCache.finish();
+
+    // Saving any of these files rebuilds its program in the background; run() swaps it in
+    shaderReloader = make_unique<ShaderReloader>(window, "resources/shaders");
+    for (const auto& p : programs) {
+        shaderReloader->watch(p.id, { { GL_VERTEX_SHADER, p.vert }, { GL_FRAGMENT_SHADER, p.frag } });
+    }
 }
 
 string Engine::getFileContents(const char* filename) {
@@ -238,50 +258,12 @@ string Engine::getFileContents(const char* filename) {
     throw(errno);
 }
 
+// Returns at once; the program is linked (or loaded from the cache) by the time shaderCache.finish() returns.
 GLuint Engine::createShader(const char* vertexFile, const char* fragmentFile) {
-    string vertexCode = this->getFileContents(vertexFile);
-    string fragmentCode = this->getFileContents(fragmentFile);
-
-    const char* vertexSource = vertexCode.c_str();
-    const char* fragmentSource = fragmentCode.c_str();
-
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexSource, NULL);
-    glCompileShader(vertexShader);
-
-    GLint success;
-    char infoLog[512];
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-        cerr << "Vertex Shader Compilation Failed:\n" << infoLog << endl;
-    }
-
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
-    glCompileShader(fragmentShader);
-
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-        cerr << "Fragment Shader Compilation Failed:\n" << infoLog << endl;
-    }
-
-    GLuint ID = glCreateProgram();
-    glAttachShader(ID, vertexShader);
-    glAttachShader(ID, fragmentShader);
-    glLinkProgram(ID);
-
-    glGetProgramiv(ID, GL_LINK_STATUS, &success);
-    if (!success) {
-        glGetProgramInfoLog(ID, 512, NULL, infoLog);
-        cerr << "Shader Linking Failed:\n" << infoLog << endl;
-    }
-    
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-
-    return ID;
+    return shaderCache.request({
+        { GL_VERTEX_SHADER, getFileContents(vertexFile), vertexFile },
+        { GL_FRAGMENT_SHADER, getFileContents(fragmentFile), fragmentFile },
+    });
 }
 
 void Engine::cycleFocus() {
@@ -293,7 +275,9 @@ void Engine::cycleFocus() {
 
 void Engine::updateCameraFocus() {
     if (registry.empty()) return;
-    this->focusTarget = *registry[focusIndex].position;
+    const RenderState& state = renderState.front();
+    int i = state.slots.find(registry[focusIndex].body);
+    if (i >= 0) this->focusTarget = state.positions[i];
 }
 
 void Engine::updateMatrices() {
@@ -314,10 +298,20 @@ void Engine::updateMatrices() {
     glBufferSubData(GL_UNIFORM_BUFFER, sizeof(mat4), sizeof(mat4), value_ptr(view));
 }
 
-Star* Engine::addStar(unique_ptr<Star> st) {
-    stars.push_back(move(st));
-    Star* starPtr = stars.back().get();
-    registry.push_back({&starPtr->position, starPtr->radius, "Star"});
+// Trail points are recorded every TRAIL_RECORD_INTERVAL wall seconds
+static const float TRAIL_RECORD_INTERVAL = 0.05f;
+static const size_t STAR_TRAIL_POINTS = 2000;
+static const size_t MAX_TRAIL_POINTS = size_t(1) << 20;
+
+Star* Engine::addStar(vec3 pos, double mass, double radius, vec3 color, double brightness, vec3 velocity) {
+    stopPhysics();
+    Star* starPtr = stars.get(stars.create(pos, mass, radius, color, brightness, velocity));
+    starPtr->trail.setCapacity(STAR_TRAIL_POINTS);
+    starPtr->body = physics.bodies.handle(physics.bodies.add(
+        starPtr->position.x, starPtr->position.y, starPtr->position.z,
+        starPtr->initialVelocity.x, starPtr->initialVelocity.y, starPtr->initialVelocity.z,
+        starPtr->mass, starPtr->radius));
+    registry.push_back({starPtr->body, starPtr->radius, "Star"});
     return starPtr;
 }
 
@@ -329,11 +323,12 @@ Planet* Engine::addPlanet(float distance, double mass, double radius, vec3 color
     );
 
     vec3 vel = vec3(0.0f, 0.0f, (float)orbVel);
+    stopPhysics();
 
-    auto newPlanet = make_unique<Planet>(pos, mass, radius, color, rotSpeed, vel);
-    Planet* planetPtr = newPlanet.get();
-    planets.push_back(move(newPlanet));
-    registry.push_back({&planetPtr->position, planetPtr->radius, "Planet"});
+    Planet* planetPtr = planets.get(planets.create(pos, mass, radius, color, rotSpeed, vel));
+    planetPtr->trail.setCapacity(orbitTrailPoints(distance, orbVel));
+    planetPtr->body = physics.bodies.handle(physics.bodies.add(pos.x, pos.y, pos.z, vel.x, vel.y, vel.z, mass, radius));
+    registry.push_back({planetPtr->body, planetPtr->radius, "Planet"});
     return planetPtr;
 }
 
@@ -343,58 +338,486 @@ void Engine::addRing(Planet* parent, double distFromPlanet, double thickness, do
     parent->rings.emplace_back(distFromPlanet, thickness, inclination, color);
 }
 
+size_t Engine::addParticleRing(size_t hostBody, double inner, double outer, double inclination, vec3 color, size_t count, double scatter) {
+    stopPhysics();
+
+    ParticleDisc disc;
+    disc.host = hostBody;
+    disc.inner = inner;
+    disc.outer = outer;
+    disc.inclination = inclination;
+    disc.scatter = scatter;
+    disc.count = count;
+    disc.seed = physics.particles.size() + 1;
+    size_t first = addParticleDisc(physics.particles, physics.bodies, physics.gravConst, disc);
+
+    // A little brightness noise per particle so the ring reads as grains rather than a sheet
+    mt19937 rng((uint32_t)disc.seed);
+    uniform_real_distribution<float> shade(0.6f, 1.0f);
+    particleColors.reserve(physics.particles.size());
+    while (particleColors.size() < physics.particles.size()) {
+        float k = 255.0f * shade(rng);
+        particleColors.push_back(u8vec4((uint8_t)min(color.r * k, 255.0f), (uint8_t)min(color.g * k, 255.0f), (uint8_t)min(color.b * k, 255.0f), 200));
+    }
+    return first;
+}
+
 Satellite* Engine::addSatellite(Planet* parent, float distFromPlanet, double mass, double radius, vec3 color, double rotSpeed, float orbitalVel) {
     if (!parent) return nullptr;
+    stopPhysics();
+    int p = physics.bodies.find(parent->body);
+    if (p < 0) return nullptr;
 
     vec3 relativePos = vec3(distFromPlanet, 0.0f, 0.0f);
     vec3 absolutePos = parent->position + relativePos;
     vec3 pureOrbitalVel = vec3(0.0f, 0.0f, orbitalVel);
     
-    parent->satellites.emplace_back(absolutePos, mass, radius, color, rotSpeed, pureOrbitalVel);
+    // Pooled, so this pointer stays valid when the planet gains more moons
+    Satellite* satPtr = satellites.get(satellites.create(absolutePos, mass, radius, color, rotSpeed, pureOrbitalVel));
+    parent->satellites.push_back(satPtr);
+    satPtr->trail.setCapacity(orbitTrailPoints(distFromPlanet, orbitalVel));
+
+    // Moves with its planet and feels only the planet's pull on top of that
+    satPtr->body = physics.bodies.handle(physics.bodies.add(
+        absolutePos.x, absolutePos.y, absolutePos.z,
+        physics.bodies.vx[p] + pureOrbitalVel.x, physics.bodies.vy[p] + pureOrbitalVel.y, physics.bodies.vz[p] + pureOrbitalVel.z,
+        mass, radius, p));
     
-    Satellite* satPtr = &parent->satellites.back();
-    
-    registry.push_back({&satPtr->position, satPtr->radius, "Moon"});
+    registry.push_back({satPtr->body, satPtr->radius, "Moon"});
     
     return satPtr;
 }
 
+bool Engine::loadScenario(const char* path) {
+    stopPhysics();
+    ephemeris.reset();
+
+    // Size the physics arrays once up front; bulk bodies then never reallocate
+    size_t expected = countScenarioRecords(path);
+    physics.bodies.reserve(physics.bodies.size() + expected);
+
+    if (isBinaryScenario(path)) {
+        size_t first = physics.bodies.size();
+        if (!appendBinaryScenario(path, physics.bodies)) return false;
+        pointBodies.reserve(pointBodies.size() + (physics.bodies.size() - first));
+        for (size_t i = first; i < physics.bodies.size(); ++i) pointBodies.push_back(physics.bodies.handle(i));
+        return true;
+    }
+
+    // Nothing reorders the bodies while loading, so plain indices will do here
+    unordered_map<string, Planet*> planetsByName;
+    unordered_map<string, size_t> bodiesByName;
+    auto indexOf = [&](BodyHandle h) { return (size_t)physics.bodies.find(h); };
+    bool ok = true;
+
+    bool parsed = readScenario(path, [&](const ScenarioBody& rec) {
+        vec3 color((float)rec.r, (float)rec.g, (float)rec.b);
+        double pos[3], vel[3];
+        scenarioState(rec, pos, vel);
+
+        Planet* parentPlanet = nullptr;
+        if (!rec.parent.empty()) {
+            auto it = planetsByName.find(rec.parent);
+            if (it != planetsByName.end()) parentPlanet = it->second;
+        }
+
+        if (rec.kind == "star") {
+            Star* st = addStar(vec3(pos[0], pos[1], pos[2]), rec.mass, rec.radius, color, rec.brightness, vec3(vel[0], vel[1], vel[2]));
+            bodiesByName[rec.name] = indexOf(st->body);
+        } else if (rec.kind == "planet") {
+            Planet* pt = addPlanet((float)rec.distance, rec.mass, rec.radius, color, rec.rotSpeed, (float)rec.orbitVel, (float)rec.inclination);
+            if (rec.hasState || rec.phase != 0.0) {
+                Bodies& b = physics.bodies;
+                size_t i = indexOf(pt->body);
+                b.x[i] = pos[0]; b.y[i] = pos[1]; b.z[i] = pos[2];
+                b.vx[i] = vel[0]; b.vy[i] = vel[1]; b.vz[i] = vel[2];
+                pt->position = vec3(pos[0], pos[1], pos[2]);
+            }
+            planetsByName[rec.name] = pt;
+            bodiesByName[rec.name] = indexOf(pt->body);
+        } else if (rec.kind == "satellite" || rec.kind == "ring") {
+            if (!parentPlanet) {
+                cerr << path << ": " << rec.kind << " '" << rec.name << "' has unknown parent '" << rec.parent << "'" << endl;
+                ok = false;
+                return;
+            }
+            if (rec.kind == "ring" && rec.count > 0) {
+                addParticleRing(indexOf(parentPlanet->body), rec.distance, rec.distance + rec.thickness, rec.inclination, color, rec.count, 1e-3);
+            } else if (rec.kind == "ring") {
+                addRing(parentPlanet, rec.distance, rec.thickness, rec.inclination, color);
+            } else {
+                Satellite* sat = addSatellite(parentPlanet, (float)rec.distance, rec.mass, rec.radius, color, rec.rotSpeed, (float)rec.orbitVel);
+                bodiesByName[rec.name] = indexOf(sat->body);
+            }
+        } else if (rec.kind == "belt") {
+            // Around the named body, or the first star; eccentricities and tilts of a few percent
+            auto it = bodiesByName.find(rec.parent);
+            if (it == bodiesByName.end() && (!rec.parent.empty() || stars.empty())) {
+                cerr << path << ": belt '" << rec.name << "' has unknown parent '" << rec.parent << "'" << endl;
+                ok = false;
+                return;
+            }
+            size_t host = it != bodiesByName.end() ? it->second : indexOf(stars.front().body);
+            addParticleRing(host, rec.distance, rec.distance + rec.thickness, rec.inclination, color, rec.count, 0.03);
+        } else if (rec.kind == "body") {
+            // Lightweight: straight into the physics arrays, no mesh or registry entry
+            int parent = -1;
+            if (!rec.parent.empty()) {
+                auto it = bodiesByName.find(rec.parent);
+                if (it != bodiesByName.end()) {
+                    Bodies& b = physics.bodies;
+                    size_t p = it->second;
+                    parent = (int)p;
+                    pos[0] += b.x[p];  pos[1] += b.y[p];  pos[2] += b.z[p];
+                    vel[0] += b.vx[p]; vel[1] += b.vy[p]; vel[2] += b.vz[p];
+                }
+            }
+            size_t i = physics.bodies.add(pos[0], pos[1], pos[2], vel[0], vel[1], vel[2], rec.mass, rec.radius, parent);
+            pointBodies.push_back(physics.bodies.handle(i));
+            if (!rec.name.empty()) bodiesByName[rec.name] = i;
+        }
+    });
+    return parsed && ok;
+}
+
 void Engine::setSimulation() {
-    bodies.clear();
-    for (auto& s : stars) {
-        bodies.emplace_back(&s->position, s->initialVelocity, s->mass);
+    stopPhysics();
+    physics.time = 0.0;
+    physics.markBodiesChanged();
+    syncFromPhysics();
+}
+
+void Engine::captureRenderState(RenderState& state) const {
+    const Bodies& b = physics.bodies;
+    size_t n = b.size();
+    state.positions.resize(n);
+    state.velocities.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        state.positions[i] = vec3((float)b.x[i], (float)b.y[i], (float)b.z[i]);
+        state.velocities[i] = vec3((float)b.vx[i], (float)b.vy[i], (float)b.vz[i]);
+    }
+
+    const TestParticles& p = physics.particles;
+    const long count = (long)p.size();
+    state.particles.resize(count);
+    #pragma omp parallel for schedule(static)
+    for (long i = 0; i < count; ++i) {
+        state.particles[i] = vec3((float)p.x[i], (float)p.y[i], (float)p.z[i]);
     }
-    for (auto& p : planets) {
-        bodies.emplace_back(&p->position, p->initialVelocity, p->mass);
+    state.slots = b.slots;
+    state.time = physics.time;
+}
+
+// A body that is gone leaves its object where it last was
+void Engine::applyRenderState(const RenderState& state) {
+    auto place = [&](vec3& position, BodyHandle body) {
+        int i = state.slots.find(body);
+        if (i >= 0) position = state.positions[i];
+    };
+    for (Star& s : stars) place(s.position, s.body);
+    for (Planet& p : planets) place(p.position, p.body);
+    for (Satellite& sat : satellites) place(sat.position, sat.body);
+}
+
+// Only valid while the physics thread is stopped: acts as both producer and consumer.
+void Engine::syncFromPhysics() {
+    captureRenderState(renderState.back());
+    renderState.publish();
+    renderState.update();
+    applyRenderState(renderState.front());
+}
+
+void Engine::startPhysics() {
+    if (physicsThread.joinable()) return;
+    syncFromPhysics();
+    physicsRunning.store(true, memory_order_release);
+    physicsThread = thread(&Engine::physicsLoop, this);
+}
+
+void Engine::stopPhysics() {
+    if (!physicsThread.joinable()) return;
+    physicsRunning.store(false, memory_order_release);
+    physicsThread.join();
+}
+
+// Advances simulated time at timeScale x wall time, independent of the frame rate.
+void Engine::physicsLoop() {
+    PROFILE_THREAD("physics");
+    using clock = chrono::steady_clock;
+    auto last = clock::now();
+    while (physicsRunning.load(memory_order_acquire)) {
+        auto now = clock::now();
+        double wall = chrono::duration<double>(now - last).count();
+        if (wall < 1e-3) {
+            // Small scenes step far faster than anyone can watch; don't burn a core on it
+            this_thread::sleep_for(chrono::microseconds(500));
+            continue;
+        }
+        last = now;
+        if (ephemeris) playbackTick(wall * timeScale.load(memory_order_relaxed));
+        else step(wall * timeScale.load(memory_order_relaxed));
     }
 }
 
-void Engine::drawTrail(const deque<vec3>& points, vec3 color) {
-    if (points.size() < 2) return;
+// Playback: no integration, just the ephemeris at the new time. Loops at either end.
+void Engine::playbackTick(double dt) {
+    PROFILE_ZONE("playback");
+    double span = ephemeris->endTime() - ephemeris->startTime();
+    double t = playbackTime + dt + pendingScrub.exchange(0.0, memory_order_relaxed) - ephemeris->startTime();
+    t = fmod(t, span);
+    if (t < 0.0) t += span;
+    playbackTime = ephemeris->startTime() + t;
+
+    ephemeris->evaluate(playbackTime, physics.bodies);
+    physics.time = playbackTime;
+    captureRenderState(renderState.back());
+    renderState.publish();
+}
 
-    glUseProgram(this->trailShaderID);
-    
-    GLuint vao, vbo;
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
+// Safe from any thread while playing back; ignored otherwise
+void Engine::scrub(double seconds) {
+    double pending = pendingScrub.load(memory_order_relaxed);
+    while (!pendingScrub.compare_exchange_weak(pending, pending + seconds, memory_order_relaxed)) {}
+}
 
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    
-    vector<vec3> tempPoints(points.begin(), points.end());
-    glBufferData(GL_ARRAY_BUFFER, tempPoints.size() * sizeof(vec3), tempPoints.data(), GL_STREAM_DRAW);
+// Integrates the current scenario over `span` simulated seconds and writes it as an ephemeris.
+// Steps are at most maxStep long (an hour if unset). Leaves the simulation at the end of the span.
+bool Engine::buildEphemeris(const string& path, double span, double segmentLength) {
+    stopPhysics();
+    ephemeris.reset();
+    bool ok = ::buildEphemeris(path.c_str(), physics, span, segmentLength, 12, maxStep > 0.0 ? maxStep : 3600.0);
+    syncFromPhysics();
+    return ok;
+}
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (void*)0);
-    glEnableVertexAttribArray(0);
+// The scenario must already be set up, as for loadSnapshot: the ephemeris supplies positions body for body.
+bool Engine::playEphemeris(const string& path) {
+    stopPhysics();
+    auto view = make_unique<EphemerisView>();
+    if (!view->open(path.c_str())) return false;
+    if (view->size() != physics.bodies.size()) {
+        cerr << "Ephemeris has " << view->size() << " bodies, scenario has " << physics.bodies.size() << endl;
+        return false;
+    }
+    ephemeris = move(view);
+    playbackTime = ephemeris->startTime();
+    ephemeris->evaluate(playbackTime, physics.bodies);
+    physics.time = playbackTime;
+    syncFromPhysics();
+    return true;
+}
+
+bool Engine::saveSnapshot(const char* path) {
+    stopPhysics();
+    return ::saveSnapshot(path, physics);
+}
+
+// The scenario must already be set up: the snapshot replaces its state body for body.
+bool Engine::loadSnapshot(const char* path) {
+    stopPhysics();
+    ephemeris.reset();
+    if (!bodyOrderFixed("Snapshots")) return false;
+    SnapshotView view;
+    if (!view.open(path)) return false;
+    if (view.size() != physics.bodies.size()) {
+        cerr << "Snapshot has " << view.size() << " bodies, scenario has " << physics.bodies.size() << endl;
+        return false;
+    }
+    // Collisions rewire the hierarchy only in known ways: a merged body rides in its absorber, satellites
+    // of a merged body move to the absorber, and a child that absorbed a body may become top-level.
+    // Every body that is not merged must otherwise keep its scenario parent.
+    const int32_t* parent = view.parent();
+    const uint8_t* merged = view.merged();
+    vector<uint8_t> absorber(view.size(), 0);
+    for (size_t i = 0; i < view.size(); ++i) {
+        if (merged[i]) absorber[parent[i]] = 1;
+    }
+    for (size_t i = 0; i < view.size(); ++i) {
+        if (merged[i]) continue;
+        int expected = physics.bodies.parent[i];
+        while (expected >= 0 && merged[expected]) expected = parent[expected];
+        if (parent[i] != expected && !(parent[i] < 0 && absorber[i])) {
+            cerr << "Snapshot hierarchy does not match the scenario at body " << i << endl;
+            return false;
+        }
+    }
+    view.close();
+
+    if (!::loadSnapshot(path, physics)) return false;
+    syncFromPhysics();
+    return true;
+}
+
+bool Engine::enableCheckpoints(const string& path, double intervalSeconds) {
+    stopPhysics();
+    if (!bodyOrderFixed("Checkpoints")) return false;
+    checkpointPath = path;
+    checkpointer = make_unique<Checkpointer>(path, intervalSeconds);
+    return true;
+}
+
+bool Engine::enableTrajectory(const string& path, uint32_t decimation) {
+    stopPhysics();
+    if (!bodyOrderFixed("Trajectories")) return false;
+    trajectory = make_unique<TrajectoryWriter>(path, physics.bodies.size(), decimation);
+    if (!trajectory->isOpen()) {
+        trajectory.reset();
+        return false;
+    }
+    return true;
+}
+
+// Rows start from the current state; the engine keeps diagnostics on from here
+bool Engine::enableDiagnostics(const string& path) {
+    stopPhysics();
+    auto writer = make_unique<DiagnosticsWriter>();
+    if (!writer->open(path)) return false;
+    physics.diagnostics = true;
+    physics.computeAccelerations();
+    writer->write(physics.metrics, 0.0);
+    diagnostics = move(writer);
+    return true;
+}
 
+// Every trail staged into one buffer with a single upload, then drawn with one multi-draw call
+void Engine::drawTrails() {
+    size_t count = 0, total = 0;
+    auto visit = [&](auto&& fn) {
+        for (Star& st : stars) fn(st.trail);
+        for (Planet& pt : planets) fn(pt.trail);
+        for (Satellite& sat : satellites) fn(sat.trail);
+    };
+    visit([&](const Trail& t) {
+        if (t.size() < 2) return;
+        ++count;
+        total += t.size();
+    });
+    if (count == 0) return;
+    PROFILE_ZONE("trail upload");
+
+    vec3* staged = frameArena.allocate<vec3>(total);
+    GLint* firsts = frameArena.allocate<GLint>(count);
+    GLsizei* counts = frameArena.allocate<GLsizei>(count);
+    size_t k = 0, offset = 0;
+    visit([&](const Trail& t) {
+        if (t.size() < 2) return;
+        t.stage(staged + offset);
+        firsts[k] = (GLint)offset;
+        counts[k] = (GLsizei)t.size();
+        offset += t.size();
+        ++k;
+    });
+
+    if (trailVAO == 0) {
+        glGenVertexArrays(1, &trailVAO);
+        glGenBuffers(1, &trailVBO);
+    }
+    glBindVertexArray(trailVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, trailVBO);
+    if (total > trailCapacity) {
+        trailCapacity = total + total / 2;
+        glBufferData(GL_ARRAY_BUFFER, trailCapacity * sizeof(vec3), nullptr, GL_STREAM_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (void*)0);
+        glEnableVertexAttribArray(0);
+    }
+    glBufferSubData(GL_ARRAY_BUFFER, 0, total * sizeof(vec3), staged);
+
+    glUseProgram(this->trailShaderID);
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    
-    glDrawArrays(GL_LINE_STRIP, 0, (GLsizei)tempPoints.size());
+    glMultiDrawArrays(GL_LINE_STRIP, firsts, counts, (GLsizei)count);
+    glDisable(GL_BLEND);
+    glBindVertexArray(0);
+}
+
+void Engine::drawPoints() {
+    if (pointBodies.empty()) return;
+
+    const RenderState& state = renderState.front();
+    vec3* pointPositions = frameArena.allocate<vec3>(pointBodies.size());
+    size_t count = 0;
+    for (BodyHandle h : pointBodies) {
+        int i = state.slots.find(h);
+        if (i >= 0) pointPositions[count++] = state.positions[i];
+    }
+    if (count == 0) return;
+
+    if (pointVAO == 0) {
+        glGenVertexArrays(1, &pointVAO);
+        glGenBuffers(1, &pointVBO);
+    }
+    glBindVertexArray(pointVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, pointVBO);
+    if (count > pointCapacity) {
+        pointCapacity = count;
+        glBufferData(GL_ARRAY_BUFFER, pointCapacity * sizeof(vec3), nullptr, GL_STREAM_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (void*)0);
+        glEnableVertexAttribArray(0);
+    }
+    glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(vec3), pointPositions);
 
+    glUseProgram(this->trailShaderID);
+    glDrawArrays(GL_POINTS, 0, (GLsizei)count);
+    glBindVertexArray(0);
+}
+
+void Engine::drawParticles() {
+    const vector<vec3>& positions = renderState.front().particles;
+    size_t n = min(positions.size(), particleColors.size());
+    if (n == 0) return;
+    PROFILE_ZONE("particle upload");
+
+    if (particleVAO == 0) {
+        static const GLfloat corners[] = { -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+        glGenVertexArrays(1, &particleVAO);
+        glGenBuffers(1, &particleQuadVBO);
+        glGenBuffers(1, &particlePositionVBO);
+        glGenBuffers(1, &particleColorVBO);
+        glBindVertexArray(particleVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, particleQuadVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), (void*)0);
+        glEnableVertexAttribArray(0);
+    }
+    glBindVertexArray(particleVAO);
+
+    // Per-instance attributes: positions every frame, colours once
+    if (n > particleCapacity) {
+        particleCapacity = n;
+        glBindBuffer(GL_ARRAY_BUFFER, particlePositionVBO);
+        glBufferData(GL_ARRAY_BUFFER, particleCapacity * sizeof(vec3), nullptr, GL_STREAM_DRAW);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribDivisor(1, 1);
+
+        glBindBuffer(GL_ARRAY_BUFFER, particleColorVBO);
+        glBufferData(GL_ARRAY_BUFFER, particleCapacity * sizeof(u8vec4), nullptr, GL_STATIC_DRAW);
+        glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(u8vec4), (void*)0);
+        glEnableVertexAttribArray(2);
+        glVertexAttribDivisor(2, 1);
+        particleColorsUploaded = 0;
+    }
+    if (particleColorsUploaded < n) {
+        glBindBuffer(GL_ARRAY_BUFFER, particleColorVBO);
+        glBufferSubData(GL_ARRAY_BUFFER, particleColorsUploaded * sizeof(u8vec4), (n - particleColorsUploaded) * sizeof(u8vec4),
+                        particleColors.data() + particleColorsUploaded);
+        particleColorsUploaded = n;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, particlePositionVBO);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, n * sizeof(vec3), positions.data());
+
+    glUseProgram(this->particleShaderID);
+    glUniform2f(glGetUniformLocation(particleShaderID, "viewport"), (float)WIDTH, (float)HEIGHT);
+    glUniform1f(glGetUniformLocation(particleShaderID, "pointSize"), 2.0f);
+
+    // Translucent sprites: blended over the scene, without hiding each other in the depth buffer
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDepthMask(GL_FALSE);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)n);
+    glDepthMask(GL_TRUE);
     glDisable(GL_BLEND);
-    glDeleteVertexArrays(1, &vao);
-    glDeleteBuffers(1, &vbo);
+    glBindVertexArray(0);
 }
 
 void Engine::drawStar(Star& st) {
@@ -423,7 +846,7 @@ void Engine::drawPlanet(Planet& pt) {
     model = scale(model, vec3(scaleFactor));
 
     glUniformMatrix4fv(glGetUniformLocation(planetShaderID, "model"), 1, GL_FALSE, value_ptr(model));
-    glUniform3fv(glGetUniformLocation(planetShaderID, "sunPos"), 1, value_ptr(stars[0]->position));
+    glUniform3fv(glGetUniformLocation(planetShaderID, "sunPos"), 1, value_ptr(stars.front().position));
     glUniform3fv(glGetUniformLocation(planetShaderID, "planetColor"), 1, value_ptr(pt.color));
 
     glBindVertexArray(pt.VAO);
@@ -444,7 +867,8 @@ void Engine::drawPlanet(Planet& pt) {
     }
 
     glUseProgram(this->satelliteShaderID);
-    for (auto& sat : pt.satellites) {
+    for (Satellite* s : pt.satellites) {
+        Satellite& sat = *s;
         sat.rotationAngle += sat.rotationSpeed * (double)deltaTime;
         mat4 satModel = mat4(1.0f);
         satModel = translate(satModel, sat.position);
@@ -452,7 +876,7 @@ void Engine::drawPlanet(Planet& pt) {
         satModel = scale(satModel, vec3(scaleFactor));
 
         glUniformMatrix4fv(glGetUniformLocation(satelliteShaderID, "model"), 1, GL_FALSE, value_ptr(satModel));
-        glUniform3fv(glGetUniformLocation(satelliteShaderID, "sunPos"), 1, value_ptr(stars[0]->position));
+        glUniform3fv(glGetUniformLocation(satelliteShaderID, "sunPos"), 1, value_ptr(stars.front().position));
         glUniform3fv(glGetUniformLocation(satelliteShaderID, "satelliteColor"), 1, value_ptr(sat.color));
 
         glBindVertexArray(sat.VAO);
@@ -461,90 +885,147 @@ void Engine::drawPlanet(Planet& pt) {
     glBindVertexArray(0);
 }
 
-void Engine::step() {
-    for (size_t i = 0; i < bodies.size(); ++i) {
-        vec3 acceleration(0.0f);
-        for (size_t j = 0; j < bodies.size(); ++j) {
-            if (i == j) continue;
-            vec3 direction = *bodies[j].position - *bodies[i].position;
-            float dist = length(direction);
-            if (dist < 1e5f) continue;
-            float forceMag = (float)((G * bodies[j].mass) / (dist * dist));
-            acceleration += normalize(direction) * forceMag;
+// Runs on the physics thread.
+void Engine::step(double dt) {
+    PROFILE_ZONE("step");
+    const double startTime = physics.time;
+    if (fixedDt > 0.0) {
+        // Falling more than 1000 steps behind slows the simulation down instead of stalling it
+        stepDebt = std::min(stepDebt + dt, 1000.0 * fixedDt);
+        while (stepDebt >= fixedDt) {
+            fixedStep();
+            stepDebt -= fixedDt;
         }
-        bodies[i].velocity += acceleration * (float)deltaTime;
+    } else {
+        int substeps = maxStep > 0.0 ? std::max(1, (int)ceil(dt / maxStep)) : 1;
+        for (int i = 0; i < substeps; ++i) physics.step(dt / substeps);
     }
 
-    static float lastTrailRecordTime = 0.0f;
-    float recordInterval = 0.05f;
-    bool shouldRecord = (currentFrame - lastTrailRecordTime >= recordInterval);
-
-    for (auto& p : planets) {
-        vec3 planetVelocity = vec3(0.0f);
-        for (auto& b : bodies) {
-            if (b.position == &p->position) {
-                planetVelocity = b.velocity;
-                break;
-            }
-        }
+    compactBodies();
+    if (checkpointer) checkpointer->maybeCheckpoint(physics);
+    if (trajectory) trajectory->push(physics.bodies, physics.time);
+    if (diagnostics) diagnostics->write(physics.metrics, physics.time - startTime); // fixed steps may carry some over
 
-        if (shouldRecord) {
-            p->trail.points.push_back(p->position);
-            float r = length(p->position - stars[0]->position);
-            float v = length(planetVelocity);
-            if (v > 0) {
-                float period = (2.0f * M_PI * r) / v;
-                size_t maxPoints = (size_t)(period / recordInterval);
-                while (p->trail.points.size() > maxPoints) p->trail.points.pop_front();
-            }
-        }
+    captureRenderState(renderState.back());
+    renderState.publish();
+}
 
-        for (auto& sat : p->satellites) {
-            vec3 direction = p->position - sat.position;
-            float dist = length(direction);
-            
-            if (dist > 1e3f) { 
-                float forceMag = (float)((G * p->mass) / (dist * dist));
-                vec3 acceleration = normalize(direction) * forceMag;
-                sat.initialOrbitalVelocity += acceleration * (float)deltaTime;
-            }
-            sat.position += (sat.initialOrbitalVelocity + planetVelocity) * (float)deltaTime;
-
-            if (shouldRecord) {
-                sat.trail.points.push_back(sat.position);
-                float vRel = length(sat.initialOrbitalVelocity);
-                if (vRel > 0) {
-                    float period = (2.0f * M_PI * dist) / vRel;
-                    size_t maxPoints = (size_t)(period / recordInterval);
-                    while (sat.trail.points.size() > maxPoints) sat.trail.points.pop_front();
-                }
-            }
-        }
+// Absorbed bodies still take a turn in every pair loop. Checkpoints, trajectories and event logs list
+// bodies by scenario index, so while any of them is attached the arrays keep their size; the scene
+// graph and camera hold handles, which follow the compaction.
+void Engine::compactBodies() {
+    if (physics.mergeCount == compactedMerges || checkpointer || trajectory || recorder) return;
+    physics.compact();
+    compactedMerges = physics.mergeCount;
+}
+
+bool Engine::bodyOrderFixed(const char* what) const {
+    if (physics.reorderInterval == 0) return true;
+    cerr << what << " list bodies by scenario index; they need reorderInterval = 0" << endl;
+    return false;
+}
+
+void Engine::fixedStep() {
+    physics.step(fixedDt);
+    ++stepCount;
+    if (recorder && stepCount % hashInterval == 0) recorder->hash(stepCount, physics.stateHash());
+}
+
+// Deterministic mode only. Call once the scenario is set up: the log starts from the current state.
+bool Engine::recordEvents(const string& path) {
+    stopPhysics();
+    if (fixedDt <= 0.0) {
+        cerr << "Recording an event log needs a fixed step" << endl;
+        return false;
     }
+    if (!bodyOrderFixed("Event logs")) return false;
+    auto log = make_unique<EventRecorder>();
+    if (!log->open(path.c_str(), fixedDt)) return false;
+    log->settings(physics);
+    stepCount = 0;
+    stepDebt = 0.0;
+    log->hash(0, physics.stateHash());
+    recorder = move(log);
+    return true;
+}
 
-    if (shouldRecord) {
-        for (auto& s : stars) {
-            s->trail.points.push_back(s->position);
-            if (s->trail.points.size() > 2000) s->trail.points.pop_front();
-        }
-        lastTrailRecordTime = currentFrame;
+// Re-runs a recorded log from the current state as fast as possible, with no rendering,
+// and checks every recorded hash. The scenario must be set up exactly as it was when recording.
+bool Engine::replayEvents(const string& path) {
+    stopPhysics();
+    EventReplay replay;
+    if (!replay.open(path.c_str()) || !replay.applySettings(physics)) return false;
+    if (!replay.verify(0, physics.stateHash())) {
+        cerr << "Initial state differs from the recording; load the same scenario and snapshot" << endl;
+        return false;
     }
 
-    for (auto& body : bodies) {
-        *body.position += body.velocity * (float)deltaTime;
+    using clock = chrono::steady_clock;
+    auto start = clock::now();
+    for (uint64_t k = 1; k <= replay.lastStep(); ++k) {
+        physics.step(replay.dt);
+        replay.verify(k, physics.stateHash());
     }
+    double wall = chrono::duration<double>(clock::now() - start).count();
+
+    cout << "Replayed " << replay.lastStep() << " steps in " << wall << " s ("
+         << replay.lastStep() / max(wall, 1e-9) << " steps/s): "
+         << (replay.mismatches() == 0 ? "bit-exact" : to_string(replay.mismatches()) + " hash mismatches") << endl;
+    syncFromPhysics();
+    return replay.mismatches() == 0;
+}
+
+// Points recorded over one orbit at the current timeScale, capped so a slow time scale can't ask for gigabytes
+size_t Engine::orbitTrailPoints(double distance, double speed) const {
+    double scale = fabs((double)timeScale.load(memory_order_relaxed));
+    if (speed <= 0.0 || scale <= 0.0) return MAX_TRAIL_POINTS;
+    double period = 2.0 * M_PI * distance / speed;
+    return (size_t)std::clamp(period / scale / TRAIL_RECORD_INTERVAL, 2.0, (double)MAX_TRAIL_POINTS);
+}
+
+void Engine::updateTrails() {
+    PROFILE_ZONE("trails");
+    const RenderState& state = renderState.front();
+    auto velocityOf = [&](BodyHandle h) {
+        int i = state.slots.find(h);
+        return i >= 0 ? state.velocities[i] : vec3(0.0f);
+    };
+
+    static float lastTrailRecordTime = 0.0f;
+    bool shouldRecord = (currentFrame - lastTrailRecordTime >= TRAIL_RECORD_INTERVAL);
+
+    if (!shouldRecord) return;
+
+    // One orbit's worth of points, up to each ring buffer's capacity
+    for (Planet& p : planets) {
+        vec3 planetVelocity = velocityOf(p.body);
+        p.trail.push(p.position, orbitTrailPoints(length(p.position - stars.front().position), length(planetVelocity)));
+
+        for (Satellite* sat : p.satellites) {
+            float vRel = length(velocityOf(sat->body) - planetVelocity);
+            sat->trail.push(sat->position, orbitTrailPoints(length(p.position - sat->position), vRel));
+        }
+    }
+
+    for (Star& s : stars) s.trail.push(s.position, STAR_TRAIL_POINTS);
+    lastTrailRecordTime = currentFrame;
 }
 
 bool Engine::run() {
     if (glfwWindowShouldClose(window)) {
+        stopPhysics();
         return false;
     }
+    startPhysics();
+    shaderReloader->apply();
 
+    frameArena.reset();
     currentFrame = (float)glfwGetTime();
     deltaTime = (currentFrame - lastFrame) * timeScale;
     lastFrame = currentFrame;
 
-    step();
+    if (renderState.update()) applyRenderState(renderState.front());
+    updateTrails();
 
     updateCameraFocus();
 
@@ -552,26 +1033,41 @@ bool Engine::run() {
 
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    for (const auto& st : this->stars) {
-        this->drawTrail(st->trail.points, st->color);
-        this->drawStar(*st);
-    }
+    {
+        PROFILE_ZONE("draw");
+        PROFILE_GPU_ZONE("draw (GPU)");
+        this->drawTrails();
+        for (Star& st : this->stars) this->drawStar(st);
+        for (Planet& pt : this->planets) this->drawPlanet(pt);
 
-    for (const auto& pt : this->planets) {
-        this->drawTrail(pt->trail.points, pt->color);
-        
-        for (const auto& sat : pt->satellites) {
-            this->drawTrail(sat.trail.points, sat.color);
-        }
-        
-        this->drawPlanet(*pt);
+        this->drawPoints();
+        this->drawParticles();
     }
 
     glfwSwapBuffers(window);
     glfwPollEvents();
+    PROFILE_GPU_COLLECT();
+    updateTitle();
     return true;
 }
 
+// Frame rate, plus the per-zone breakdown when built with -DCOSMOS_PROFILE
+void Engine::updateTitle() {
+    titleFrames++;
+    double now = glfwGetTime();
+    if (now - lastTitleTime < 1.0) return;
+
+    // Formatted in place: no strings are built unless the profiler has zones to report
+    char title[512];
+    int len = snprintf(title, sizeof(title), "Solar System | %d fps", int(titleFrames / (now - lastTitleTime)));
+    string zones = PROFILE_SUMMARY(titleFrames);
+    if (!zones.empty()) snprintf(title + len, sizeof(title) - len, " | %s", zones.c_str());
+    glfwSetWindowTitle(window, title);
+
+    titleFrames = 0;
+    lastTitleTime = now;
+}
+
 void Engine::mouse_callback(GLFWwindow* w, double x, double y) {
     auto* e = (Engine*)glfwGetWindowUserPointer(w);
     float dx = (float)(x - e->lastX);
@@ -611,28 +1107,63 @@ void Engine::scroll_callback(GLFWwindow* w, double x, double y) {
 }
 
 Engine::~Engine() {
-    for (auto& star : stars) {
-        glDeleteVertexArrays(1, &star->VAO);
-        glDeleteBuffers(1, &star->VBO);
-        glDeleteBuffers(1, &star->EBO);
+    stopPhysics();
+    if (recorder && recorder->lastHashStep() != stepCount) recorder->hash(stepCount, physics.stateHash());
+    recorder.reset();
+    shaderReloader.reset();
+    PROFILE_EXPORT("trace.json");
+
+    // Final state goes to disk synchronously so a clean exit never loses progress
+    if (checkpointer) {
+        checkpointer.reset();
+        ::saveSnapshot(checkpointPath.c_str(), physics);
+    }
+
+    diagnostics.reset();
+
+    if (trajectory) {
+        uint64_t dropped = trajectory->framesDropped();
+        trajectory.reset();  // drains queued frames and flushes the last chunk
+        if (dropped) cerr << "Trajectory: dropped " << dropped << " frames (disk could not keep up)" << endl;
     }
 
-    for (auto& planet : planets) {
-        glDeleteVertexArrays(1, &planet->VAO);
-        glDeleteBuffers(1, &planet->VBO);
-        glDeleteBuffers(1, &planet->EBO);
+    for (Star& star : stars) {
+        glDeleteVertexArrays(1, &star.VAO);
+        glDeleteBuffers(1, &star.VBO);
+        glDeleteBuffers(1, &star.EBO);
+    }
 
-        for (auto& ring : planet->rings) {
+    for (Planet& planet : planets) {
+        glDeleteVertexArrays(1, &planet.VAO);
+        glDeleteBuffers(1, &planet.VBO);
+        glDeleteBuffers(1, &planet.EBO);
+
+        for (auto& ring : planet.rings) {
             glDeleteVertexArrays(1, &ring.VAO);
             glDeleteBuffers(1, &ring.VBO);
             glDeleteBuffers(1, &ring.EBO);
         }
+    }
 
-        for (auto& sat : planet->satellites) {
-            glDeleteVertexArrays(1, &sat.VAO);
-            glDeleteBuffers(1, &sat.VBO);
-            glDeleteBuffers(1, &sat.EBO);
-        }
+    for (Satellite& sat : satellites) {
+        glDeleteVertexArrays(1, &sat.VAO);
+        glDeleteBuffers(1, &sat.VBO);
+        glDeleteBuffers(1, &sat.EBO);
+    }
+
+    if (pointVAO) {
+        glDeleteVertexArrays(1, &pointVAO);
+        glDeleteBuffers(1, &pointVBO);
+    }
+    if (trailVAO) {
+        glDeleteVertexArrays(1, &trailVAO);
+        glDeleteBuffers(1, &trailVBO);
+    }
+    if (particleVAO) {
+        glDeleteVertexArrays(1, &particleVAO);
+        glDeleteBuffers(1, &particleQuadVBO);
+        glDeleteBuffers(1, &particlePositionVBO);
+        glDeleteBuffers(1, &particleColorVBO);
     }
 
     glDeleteBuffers(1, &uboWindowData);
@@ -1,7 +1,7 @@
 #include "rayEngine.h"
 
 vec3 Camera::position() const {
-    float clampedElevation = clamp(elevation, 0.01f, float(M_PI) - 0.01f);
+    float clampedElevation = glm::clamp(elevation, 0.01f, float(M_PI) - 0.01f);
     return vec3(
         radius * sin(clampedElevation) * cos(azimuth),
         radius * cos(clampedElevation),
@@ -115,6 +115,7 @@ Engine::Engine() {
     gridShaderID = createShader("resources/shaders/grid.vert", "resources/shaders/grid.frag");
 
     computeShaderID = createComputeShader("resources/shaders/geodesic.comp");
+    gridComputeShaderID = createComputeShader("resources/shaders/grid.comp");
     glGenBuffers(1, &cameraUBO);
     glBindBuffer(GL_UNIFORM_BUFFER, cameraUBO);
     glBufferData(GL_UNIFORM_BUFFER, 128, nullptr, GL_DYNAMIC_DRAW);
@@ -125,67 +126,45 @@ Engine::Engine() {
     glBufferData(GL_UNIFORM_BUFFER, sizeof(float) * 4, nullptr, GL_DYNAMIC_DRAW);
     glBindBufferBase(GL_UNIFORM_BUFFER, 2, diskUBO);
 
-    glGenBuffers(1, &objectsUBO);
-    glBindBuffer(GL_UNIFORM_BUFFER, objectsUBO);
+    glGenBuffers(1, &objectsSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, objectsSSBO);
 
-    GLsizeiptr objUBOSize = sizeof(int) + 3 * sizeof(float)
-        + 16 * (sizeof(vec4) + sizeof(vec4))
-        + 16 * sizeof(float);
-    glBufferData(GL_UNIFORM_BUFFER, objUBOSize, nullptr, GL_DYNAMIC_DRAW);
-    glBindBufferBase(GL_UNIFORM_BUFFER, 3, objectsUBO);
+    glGenBuffers(1, &objectGridSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, objectGridSSBO);
 
     auto result = QuadVAO();
     this->quadVAO = result[0];
     this->texture = result[1];
-}
-
-void Engine::generateGrid(const vector<ObjectData>& objects) {
-    const int gridSize = 25;
-    const float spacing = 1e10f;
-
-    vector<vec3> vertices;
-    vector<GLuint> indices;
-
-    for (int z = 0; z <= gridSize; ++z) {
-        for (int x = 0; x <= gridSize; ++x) {
-            float worldX = (x - gridSize / 2) * spacing;
-            float worldZ = (z - gridSize / 2) * spacing;
-
-            float y = 0.0f;
 
-            for (const auto& obj : objects) {
-                vec3 objPos = vec3(obj.posRadius);
-                double mass = obj.mass;
-                double radius = obj.posRadius.w;
+    // A broken shader is reported but not fatal: fix it and save, and the reloader swaps it in
+    if (!shaderCache.finish()) cerr << "Shader build failed; edit the file to retry" << endl;
 
-                double r_s = 2.0 * G * mass / (c * c);
-                double dx = worldX - objPos.x;
-                double dz = worldZ - objPos.z;
-                double dist = sqrt(dx * dx + dz * dz);
-
-                if (dist > r_s) {
-                    double deltaY = 2.0 * sqrt(r_s * (dist - r_s));
-                    y += static_cast<float>(deltaY) - 3e10f;
-                } else {
-                    y += 2.0f * static_cast<float>(sqrt(r_s * r_s)) - 3e10f;  // or add a deep pit
-                }
-            }
+    shaderReloader = make_unique<ShaderReloader>(window, "resources/shaders");
+    shaderReloader->watch(&shaderID, { { GL_VERTEX_SHADER, "resources/shaders/default.vert" }, { GL_FRAGMENT_SHADER, "resources/shaders/default.frag" } });
+    shaderReloader->watch(&gridShaderID, { { GL_VERTEX_SHADER, "resources/shaders/grid.vert" }, { GL_FRAGMENT_SHADER, "resources/shaders/grid.frag" } });
+    shaderReloader->watch(&computeShaderID, { { GL_COMPUTE_SHADER, "resources/shaders/geodesic.comp" } });
+    shaderReloader->watch(&gridComputeShaderID, { { GL_COMPUTE_SHADER, "resources/shaders/grid.comp" } });
+}
 
-            vertices.emplace_back(worldX, y, worldZ);
-        }
-    }
+// Allocates the grid buffers and writes the static line indices; only needed when gridSize changes.
+void Engine::buildGridMesh() {
+    const int row = gridSize + 1;
+    vector<GLuint> indices;
+    indices.reserve(size_t(gridSize) * gridSize * 4);
 
     for (int z = 0; z < gridSize; ++z) {
         for (int x = 0; x < gridSize; ++x) {
-            int i = z * (gridSize + 1) + x;
+            int i = z * row + x;
             indices.push_back(i);
             indices.push_back(i + 1);
 
             indices.push_back(i);
-            indices.push_back(i + gridSize + 1);
+            indices.push_back(i + row);
         }
     }
 
+    gridVertices.resize(size_t(row) * row);
+
     if (gridVAO == 0) glGenVertexArrays(1, &gridVAO);
     if (gridVBO == 0) glGenBuffers(1, &gridVBO);
     if (gridEBO == 0) glGenBuffers(1, &gridEBO);
@@ -193,7 +172,7 @@ void Engine::generateGrid(const vector<ObjectData>& objects) {
     glBindVertexArray(gridVAO);
 
     glBindBuffer(GL_ARRAY_BUFFER, gridVBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(vec3), vertices.data(), GL_DYNAMIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, gridVertices.size() * sizeof(vec3), nullptr, GL_DYNAMIC_DRAW);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gridEBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
@@ -202,11 +181,41 @@ void Engine::generateGrid(const vector<ObjectData>& objects) {
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (void*)0);
 
     gridIndexCount = indices.size();
+    gridBuiltSize = gridSize;
+    gridVersion = UINT64_MAX;
 
     glBindVertexArray(0);
 }
 
+void Engine::generateGrid(const vector<ObjectData>& objects) {
+    PROFILE_ZONE("generateGrid");
+    PROFILE_GPU_ZONE("generateGrid (GPU)");
+    if (gridBuiltSize != gridSize) buildGridMesh();
+    if (gridVersion == objectsVersion) return; // nothing moved since the last rebuild
+
+    if (gpuGrid) {
+        // Displace straight into the VBO; no vertex data crosses the bus
+        uploadObjects(objects);
+
+        glUseProgram(gridComputeShaderID);
+        glUniform1i(glGetUniformLocation(gridComputeShaderID, "gridSize"), gridSize);
+        glUniform1f(glGetUniformLocation(gridComputeShaderID, "gridSpacing"), gridSpacing);
+        glUniform1f(glGetUniformLocation(gridComputeShaderID, "rsPerKg"), schwarzschildPerKg());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, gridVBO);
+
+        GLuint groups = (GLuint)std::ceil((gridSize + 1) / 16.0f);
+        glDispatchCompute(groups, groups, 1);
+        glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    } else {
+        displaceGrid(objects.data(), objects.size(), gridSize, gridSpacing, gridVertices.data());
+        glBindBuffer(GL_ARRAY_BUFFER, gridVBO);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, gridVertices.size() * sizeof(vec3), gridVertices.data());
+    }
+    gridVersion = objectsVersion;
+}
+
 void Engine::drawGrid(const mat4& viewProj) {
+    PROFILE_GPU_ZONE("drawGrid (GPU)");
     glUseProgram(gridShaderID);
     glUniformMatrix4fv(glGetUniformLocation(gridShaderID, "viewProj"),
                     1, GL_FALSE, glm::value_ptr(viewProj));
@@ -250,88 +259,21 @@ string Engine::getFileContents(const char* filename) {
     throw(errno);
 }
 
+// Both return at once; programs are linked (or loaded from the cache) by the time shaderCache.finish() returns.
 GLuint Engine::createShader(const char* vertexFile, const char* fragmentFile) {
-    string vertexCode = this->getFileContents(vertexFile);
-    string fragmentCode = this->getFileContents(fragmentFile);
-
-    const char* vertexSource = vertexCode.c_str();
-    const char* fragmentSource = fragmentCode.c_str();
-
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexSource, NULL);
-    glCompileShader(vertexShader);
-
-    GLint success;
-    char infoLog[512];
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-        cerr << "Vertex Shader Compilation Failed:\n" << infoLog << endl;
-    }
-
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
-    glCompileShader(fragmentShader);
-
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-        cerr << "Fragment Shader Compilation Failed:\n" << infoLog << endl;
-    }
-
-    GLuint ID = glCreateProgram();
-    glAttachShader(ID, vertexShader);
-    glAttachShader(ID, fragmentShader);
-    glLinkProgram(ID);
-
-    glGetProgramiv(ID, GL_LINK_STATUS, &success);
-    if (!success) {
-        glGetProgramInfoLog(ID, 512, NULL, infoLog);
-        cerr << "Shader Linking Failed:\n" << infoLog << endl;
-    }
-    
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-
-    return ID;
+    return shaderCache.request({
+        { GL_VERTEX_SHADER, getFileContents(vertexFile), vertexFile },
+        { GL_FRAGMENT_SHADER, getFileContents(fragmentFile), fragmentFile },
+    });
 }
 
 GLuint Engine::createComputeShader(const char* computeFile) {
-    string computeCode = this->getFileContents(computeFile);
-    const char* computeSource = computeCode.c_str();
-
-    GLuint cs = glCreateShader(GL_COMPUTE_SHADER);
-    glShaderSource(cs, 1, &computeSource, nullptr);
-    glCompileShader(cs);
-    GLint ok; 
-    glGetShaderiv(cs, GL_COMPILE_STATUS, &ok);
-    if(!ok) {
-        GLint logLen;
-        glGetShaderiv(cs, GL_INFO_LOG_LENGTH, &logLen);
-        std::vector<char> log(logLen);
-        glGetShaderInfoLog(cs, logLen, nullptr, log.data());
-        std::cerr << "Compute shader compile error:\n" << log.data() << "\n";
-        exit(EXIT_FAILURE);
-    }
-
-    GLuint prog = glCreateProgram();
-    glAttachShader(prog, cs);
-    glLinkProgram(prog);
-    glGetProgramiv(prog, GL_LINK_STATUS, &ok);
-    if(!ok) {
-        GLint logLen;
-        glGetProgramiv(prog, GL_INFO_LOG_LENGTH, &logLen);
-        std::vector<char> log(logLen);
-        glGetProgramInfoLog(prog, logLen, nullptr, log.data());
-        std::cerr << "Compute shader link error:\n" << log.data() << "\n";
-        exit(EXIT_FAILURE);
-    }
-
-    glDeleteShader(cs);
-    return prog;
+    return shaderCache.request({ { GL_COMPUTE_SHADER, getFileContents(computeFile), computeFile } });
 }
 
 void Engine::dispatchCompute(const Camera& cam) {
+    PROFILE_ZONE("dispatchCompute");
+    PROFILE_GPU_ZONE("geodesic (GPU)");
     int cw = cam.moving ? COMPUTE_WIDTH  : 200;
     int ch = cam.moving ? COMPUTE_HEIGHT : 150;
 
@@ -348,7 +290,11 @@ void Engine::dispatchCompute(const Camera& cam) {
     glUseProgram(computeShaderID);
     uploadCameraUBO(cam);
     uploadDiskUBO();
-    uploadObjectsUBO(objects);
+    uploadObjects(objects);
+    if (objectGridVersion != objectsVersion) {
+        uploadObjectGrid(objects);
+        objectGridVersion = objectsVersion;
+    }
 
     glBindImageTexture(0, texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
 
@@ -387,26 +333,83 @@ void Engine::uploadCameraUBO(const Camera& cam) {
     glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(UBOData), &data);
 }
 
-void Engine::uploadObjectsUBO(const vector<ObjectData>& objs) {
-    struct UBOData {
-        int   numObjects;
-        float _pad0, _pad1, _pad2;
-        vec4  posRadius[16];
-        vec4  color[16];
-        float  mass[16]; 
-    } data;
+void Engine::markObjectsDirty(size_t first, size_t count) {
+    if (count == 0) return;
+    objectsVersion++;
+    if (objectsDirtyBegin >= objectsDirtyEnd) {
+        objectsDirtyBegin = first;
+        objectsDirtyEnd = first + count;
+    } else {
+        objectsDirtyBegin = std::min(objectsDirtyBegin, first);
+        objectsDirtyEnd = std::max(objectsDirtyEnd, first + count);
+    }
+}
 
-    size_t count = std::min(objs.size(), size_t(16));
-    data.numObjects = static_cast<int>(count);
+// Returns true if anything was written. A change in object count also bumps
+// objectsVersion so the object grid and curvature grid get rebuilt.
+bool Engine::uploadObjects(const vector<ObjectData>& objs) {
+    // std430: uint numObjects, padded to 16 bytes, followed by the Object array
+    const GLsizeiptr headerSize = 4 * sizeof(GLuint);
+    size_t count = objs.size();
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, objectsSSBO);
+    if (count > objectsCapacity || objectsCapacity == 0) {
+        objectsCapacity = std::max(count * 2, size_t(16));
+        glBufferData(GL_SHADER_STORAGE_BUFFER, headerSize + objectsCapacity * sizeof(ObjectData), nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, objectsSSBO);
+        objectsUploaded = SIZE_MAX;
+        objectsDirtyBegin = 0;
+        objectsDirtyEnd = count;
+    }
+
+    bool changed = false;
+    if (count != objectsUploaded) {
+        GLuint header[4] = { (GLuint)count, 0, 0, 0 };
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, headerSize, header);
+        // Entries appended since the last upload go up even if nobody marked them dirty
+        size_t tail = std::min(objectsUploaded, count);
+        markObjectsDirty(tail, count - tail);
+        if (objectsUploaded != SIZE_MAX) objectsVersion++;
+        objectsUploaded = count;
+        changed = true;
+    }
 
-    for (size_t i = 0; i < count; ++i) {
-        data.posRadius[i] = objs[i].posRadius;
-        data.color[i] = objs[i].color;
-        data.mass[i] = objs[i].mass;
+    size_t end = std::min(objectsDirtyEnd, count);
+    if (objectsDirtyBegin < end) {
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER,
+                        headerSize + objectsDirtyBegin * sizeof(ObjectData),
+                        (end - objectsDirtyBegin) * sizeof(ObjectData),
+                        objs.data() + objectsDirtyBegin);
+        changed = true;
     }
+    objectsDirtyBegin = objectsDirtyEnd = 0;
+    return changed;
+}
+
+void Engine::uploadObjectGrid(const vector<ObjectData>& objs) {
+    objectGrid.build(objs.data(), objs.size());
+
+    struct Header {
+        vec4  origin;
+        ivec4 dims;
+        vec4  bounds;
+    } header = { objectGrid.origin, objectGrid.dims, objectGrid.bounds };
 
-    glBindBuffer(GL_UNIFORM_BUFFER, objectsUBO);
-    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(data), &data);
+    GLsizeiptr startBytes = objectGrid.cellStart.size() * sizeof(GLuint);
+    GLsizeiptr objectBytes = objectGrid.cellObjects.size() * sizeof(GLuint);
+    GLsizeiptr total = sizeof(Header) + startBytes + objectBytes;
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, objectGridSSBO);
+    if (total > objectGridCapacity) {
+        objectGridCapacity = total * 2;
+        glBufferData(GL_SHADER_STORAGE_BUFFER, objectGridCapacity, nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, objectGridSSBO);
+    }
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(Header), &header);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(Header), startBytes, objectGrid.cellStart.data());
+    if (objectBytes > 0) {
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(Header) + startBytes, objectBytes, objectGrid.cellObjects.data());
+    }
 }
 
 void Engine::uploadDiskUBO() {
@@ -0,0 +1,333 @@
+#include "scenario.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include "snapshot.h"
+
+using namespace std;
+
+static bool endsWith(const string& s, const char* suffix) {
+    size_t n = strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+static string trim(const string& s) {
+    size_t a = s.find_first_not_of(" \t\r\n");
+    if (a == string::npos) return "";
+    size_t b = s.find_last_not_of(" \t\r\n");
+    return s.substr(a, b - a + 1);
+}
+
+// Assigns one key/value pair; unknown keys are ignored so files can carry extra columns
+static void setField(ScenarioBody& body, const string& key, const string& value) {
+    auto num = [&]() { return strtod(value.c_str(), nullptr); };
+    auto state = [&](double& field) { field = num(); body.hasState = true; };
+
+    if (key == "kind") body.kind = value;
+    else if (key == "name") body.name = value;
+    else if (key == "parent") body.parent = value;
+    else if (key == "x") state(body.x);
+    else if (key == "y") state(body.y);
+    else if (key == "z") state(body.z);
+    else if (key == "vx") state(body.vx);
+    else if (key == "vy") state(body.vy);
+    else if (key == "vz") state(body.vz);
+    else if (key == "mass") body.mass = num();
+    else if (key == "radius") body.radius = num();
+    else if (key == "r") body.r = num();
+    else if (key == "g") body.g = num();
+    else if (key == "b") body.b = num();
+    else if (key == "brightness") body.brightness = num();
+    else if (key == "distance") body.distance = num();
+    else if (key == "orbitVel") body.orbitVel = num();
+    else if (key == "inclination") body.inclination = num();
+    else if (key == "phase") body.phase = num();
+    else if (key == "rotSpeed") body.rotSpeed = num();
+    else if (key == "thickness") body.thickness = num();
+    else if (key == "count") body.count = (size_t)num();
+}
+
+bool isBinaryScenario(const char* path) {
+    return endsWith(path, ".snap");
+}
+
+size_t countScenarioRecords(const char* path) {
+    if (isBinaryScenario(path)) {
+        SnapshotView view;
+        return view.open(path) ? view.size() : 0;
+    }
+
+    ifstream in(path, ios::binary);
+    if (!in) return 0;
+
+    // Lines for CSV, opening braces for JSON: both over-count slightly, never under-count
+    char marker = endsWith(path, ".json") ? '{' : '\n';
+    size_t count = 0;
+    vector<char> chunk(1 << 16);
+    while (in) {
+        in.read(chunk.data(), chunk.size());
+        streamsize got = in.gcount();
+        for (streamsize i = 0; i < got; ++i) count += chunk[i] == marker;
+    }
+    return count + 1;
+}
+
+static bool readCSV(const char* path, const ScenarioSink& sink) {
+    ifstream in(path);
+    if (!in) {
+        cerr << "Could not open scenario: " << path << endl;
+        return false;
+    }
+
+    vector<string> columns;
+    ScenarioBody body;
+    string line, cell;
+    size_t lineNo = 0;
+    while (getline(in, line)) {
+        ++lineNo;
+        string t = trim(line);
+        if (t.empty() || t[0] == '#') continue;
+
+        size_t start = 0, col = 0;
+        if (columns.empty()) {
+            while (start <= t.size()) {
+                size_t end = t.find(',', start);
+                if (end == string::npos) end = t.size();
+                columns.push_back(trim(t.substr(start, end - start)));
+                start = end + 1;
+            }
+            continue;
+        }
+
+        body.reset();
+        while (start <= t.size() && col < columns.size()) {
+            size_t end = t.find(',', start);
+            if (end == string::npos) end = t.size();
+            cell = trim(t.substr(start, end - start));
+            if (!cell.empty()) setField(body, columns[col], cell);
+            start = end + 1;
+            ++col;
+        }
+        if (body.kind.empty()) {
+            cerr << path << ":" << lineNo << ": record has no kind" << endl;
+            return false;
+        }
+        sink(body);
+    }
+    return true;
+}
+
+// Minimal streaming JSON reader: enough for arrays of flat objects whose values are
+// numbers, strings, or short arrays of numbers ("color": [r, g, b], "position": [x, y, z]).
+struct JsonStream {
+    streambuf* buf;
+    bool failed = false;
+
+    int peek() { return buf->sgetc(); }
+    int get() { return buf->sbumpc(); }
+
+    int skipSpace() {
+        int ch = peek();
+        while (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r') { get(); ch = peek(); }
+        return ch;
+    }
+
+    bool expect(char want) {
+        if (skipSpace() != want) { failed = true; return false; }
+        get();
+        return true;
+    }
+
+    string readString() {
+        string out;
+        if (!expect('"')) return out;
+        for (int ch = get(); ch != '"' && ch != EOF; ch = get()) {
+            if (ch == '\\') ch = get();
+            out.push_back((char)ch);
+        }
+        return out;
+    }
+
+    string readScalar() {
+        if (skipSpace() == '"') return readString();
+        string out;
+        for (int ch = peek(); ch != EOF && ch != ',' && ch != '}' && ch != ']' && !isspace(ch); ch = peek()) {
+            out.push_back((char)get());
+        }
+        return out;
+    }
+};
+
+static bool readJSON(const char* path, const ScenarioSink& sink) {
+    ifstream in(path, ios::binary);
+    if (!in) {
+        cerr << "Could not open scenario: " << path << endl;
+        return false;
+    }
+
+    JsonStream js{ in.rdbuf() };
+    // Accept either a bare array or {"bodies": [...]}
+    if (js.skipSpace() == '{') {
+        js.get();
+        string key = js.readString();
+        if (key != "bodies" || !js.expect(':')) {
+            cerr << path << ": expected a \"bodies\" array" << endl;
+            return false;
+        }
+    }
+    if (!js.expect('[')) {
+        cerr << path << ": expected an array of bodies" << endl;
+        return false;
+    }
+
+    static const char* vectorKeys[][4] = {
+        { "color", "r", "g", "b" },
+        { "position", "x", "y", "z" },
+        { "velocity", "vx", "vy", "vz" },
+    };
+
+    ScenarioBody body;
+    while (js.skipSpace() == '{') {
+        js.get();
+        body.reset();
+        while (js.skipSpace() == '"') {
+            string key = js.readString();
+            js.expect(':');
+            if (js.skipSpace() == '[') {
+                js.get();
+                const char* const* names = nullptr;
+                for (auto& v : vectorKeys) if (key == v[0]) names = v + 1;
+                for (int i = 0; js.skipSpace() != ']' && !js.failed; ++i) {
+                    string value = js.readScalar();
+                    if (names && i < 3) setField(body, names[i], value);
+                    if (js.skipSpace() == ',') js.get();
+                }
+                js.expect(']');
+            } else {
+                setField(body, key, js.readScalar());
+            }
+            if (js.skipSpace() == ',') js.get();
+        }
+        if (!js.expect('}') || js.failed) break;
+        if (body.kind.empty()) {
+            cerr << path << ": record has no kind" << endl;
+            return false;
+        }
+        sink(body);
+        if (js.skipSpace() == ',') js.get();
+    }
+
+    if (js.failed || !js.expect(']')) {
+        cerr << path << ": malformed JSON" << endl;
+        return false;
+    }
+    return true;
+}
+
+bool readScenario(const char* path, const ScenarioSink& sink) {
+    if (endsWith(path, ".json")) return readJSON(path, sink);
+    if (endsWith(path, ".csv")) return readCSV(path, sink);
+    cerr << "Unknown scenario format (expected .csv, .json or .snap): " << path << endl;
+    return false;
+}
+
+bool appendBinaryScenario(const char* path, Bodies& bodies) {
+    // open() has checked every parent is an earlier body of this file, so the offset ones stay valid here
+    SnapshotView view;
+    if (!view.open(path)) return false;
+
+    const size_t base = bodies.size();
+    const size_t n = view.size();
+    bodies.resize(base + n);
+
+    vector<double>* columns[] = {
+        &bodies.x, &bodies.y, &bodies.z, &bodies.vx, &bodies.vy, &bodies.vz, &bodies.mass, &bodies.radius
+    };
+    for (uint32_t f = 0; f < SNAP_PARENT; ++f) {
+        memcpy(columns[f]->data() + base, view.field((SnapshotField)f), n * sizeof(double));
+    }
+    const int32_t* parent = view.parent();
+    for (size_t i = 0; i < n; ++i) {
+        bodies.parent[base + i] = parent[i] < 0 ? -1 : parent[i] + (int)base;
+    }
+    memcpy(bodies.merged.data() + base, view.merged(), n);
+    return true;
+}
+
+void scenarioState(const ScenarioBody& body, double pos[3], double vel[3]) {
+    if (body.hasState) {
+        pos[0] = body.x;  pos[1] = body.y;  pos[2] = body.z;
+        vel[0] = body.vx; vel[1] = body.vy; vel[2] = body.vz;
+        return;
+    }
+
+    // Same float rounding as Engine::addPlanet, so scenario files reproduce the old setup
+    float d = (float)body.distance, inc = (float)body.inclination;
+    double px = d * std::cos(inc), py = d * std::sin(inc);
+    double c = std::cos(body.phase), s = std::sin(body.phase);
+    pos[0] = px * c;
+    pos[1] = py;
+    pos[2] = -px * s;
+    vel[0] = (float)body.orbitVel * s;
+    vel[1] = 0.0;
+    vel[2] = (float)body.orbitVel * c;
+}
+
+bool loadScenarioBodies(const char* path, Bodies& bodies, const function<void(ScenarioBody&)>& edit) {
+    bodies.reserve(bodies.size() + countScenarioRecords(path));
+    if (isBinaryScenario(path)) return appendBinaryScenario(path, bodies);
+
+    unordered_map<string, size_t> planetsByName, bodiesByName;
+    bool ok = true;
+    bool parsed = readScenario(path, [&](const ScenarioBody& record) {
+        ScenarioBody rec = record;
+        if (edit) edit(rec);
+        double pos[3], vel[3];
+        scenarioState(rec, pos, vel);
+
+        if (rec.kind == "star" || rec.kind == "planet") {
+            // Star keeps its state in float vectors before it reaches the physics arrays
+            if (rec.kind == "star") {
+                for (int k = 0; k < 3; ++k) {
+                    pos[k] = (float)pos[k];
+                    vel[k] = (float)vel[k];
+                }
+            }
+            size_t i = bodies.add(pos[0], pos[1], pos[2], vel[0], vel[1], vel[2], rec.mass, rec.radius);
+            if (rec.kind == "planet") planetsByName[rec.name] = i;
+            bodiesByName[rec.name] = i;
+        } else if (rec.kind == "satellite") {
+            // Engine::addSatellite: distance along +x and orbitVel along +z from the planet, as a child
+            auto it = planetsByName.find(rec.parent);
+            if (it == planetsByName.end()) {
+                cerr << path << ": satellite '" << rec.name << "' has unknown parent '" << rec.parent << "'" << endl;
+                ok = false;
+                return;
+            }
+            size_t p = it->second;
+            float d = (float)rec.distance, v = (float)rec.orbitVel;
+            size_t i = bodies.add((float)bodies.x[p] + d, (float)bodies.y[p], (float)bodies.z[p],
+                                  bodies.vx[p], bodies.vy[p], bodies.vz[p] + v, rec.mass, rec.radius, (int)p);
+            bodiesByName[rec.name] = i;
+        } else if (rec.kind == "body") {
+            int parent = -1;
+            auto it = rec.parent.empty() ? bodiesByName.end() : bodiesByName.find(rec.parent);
+            if (it != bodiesByName.end()) {
+                size_t p = it->second;
+                parent = (int)p;
+                pos[0] += bodies.x[p];  pos[1] += bodies.y[p];  pos[2] += bodies.z[p];
+                vel[0] += bodies.vx[p]; vel[1] += bodies.vy[p]; vel[2] += bodies.vz[p];
+            }
+            size_t i = bodies.add(pos[0], pos[1], pos[2], vel[0], vel[1], vel[2], rec.mass, rec.radius, parent);
+            if (!rec.name.empty()) bodiesByName[rec.name] = i;
+        }
+    });
+    return parsed && ok;
+}
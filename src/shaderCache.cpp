@@ -0,0 +1,189 @@
+#include "shaderCache.h"
+
+#include <GLFW/glfw3.h>
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+constexpr char CACHE_MAGIC[8] = { 'C', 'G', 'L', 'P', 'R', 'O', 'G', '\0' };
+
+struct CacheHeader {
+    char     magic[8];
+    uint64_t hash;
+    uint32_t format; // binaryFormat from glGetProgramBinary
+    uint32_t length;
+};
+
+typedef void (*MaxShaderCompilerThreadsProc)(GLuint count);
+
+// FNV-1a; collisions only cost a failed glProgramBinary and a recompile
+static uint64_t fnv1a(const void* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static string glString(GLenum name) {
+    const GLubyte* s = glGetString(name);
+    return s ? string((const char*)s) : string();
+}
+
+ShaderCache::ShaderCache(string dir) : dir(move(dir)) {}
+
+void ShaderCache::init() {
+    initialized = true;
+    driver = glString(GL_VENDOR) + "|" + glString(GL_RENDERER) + "|" + glString(GL_VERSION);
+
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    binariesSupported = formats > 0;
+    if (binariesSupported) {
+        error_code ec;
+        filesystem::create_directories(dir, ec);
+        if (ec) {
+            cerr << "Shader cache disabled, cannot create " << dir << ": " << ec.message() << endl;
+            binariesSupported = false;
+        }
+    }
+
+    // Let the driver use as many compiler threads as it likes (0xFFFFFFFF = implementation maximum)
+    const char* procs[][2] = {
+        { "GL_KHR_parallel_shader_compile", "glMaxShaderCompilerThreadsKHR" },
+        { "GL_ARB_parallel_shader_compile", "glMaxShaderCompilerThreadsARB" },
+    };
+    for (auto& p : procs) {
+        if (!glfwExtensionSupported(p[0])) continue;
+        auto setThreads = (MaxShaderCompilerThreadsProc)glfwGetProcAddress(p[1]);
+        if (setThreads) {
+            setThreads(0xFFFFFFFFu);
+            break;
+        }
+    }
+}
+
+string ShaderCache::pathFor(uint64_t hash) const {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)hash);
+    return dir + "/" + name;
+}
+
+GLuint ShaderCache::request(const vector<ShaderStage>& stages) {
+    if (!initialized) init();
+
+    uint64_t hash = fnv1a(driver.data(), driver.size());
+    for (const auto& stage : stages) {
+        hash = fnv1a(&stage.type, sizeof(stage.type), hash);
+        hash = fnv1a(stage.source.data(), stage.source.size(), hash);
+    }
+
+    GLuint program = glCreateProgram();
+    if (binariesSupported && loadBinary(program, hash)) return program;
+
+    Pending p = { program, hash, {}, {} };
+    for (const auto& stage : stages) {
+        GLuint shader = glCreateShader(stage.type);
+        const char* src = stage.source.c_str();
+        glShaderSource(shader, 1, &src, nullptr);
+        glCompileShader(shader);
+        glAttachShader(program, shader);
+        p.shaders.push_back(shader);
+        p.labels.push_back(stage.label);
+    }
+    if (binariesSupported) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(program);
+
+    pending.push_back(move(p));
+    return program;
+}
+
+bool ShaderCache::finish() {
+    bool allOk = true;
+    for (auto& p : pending) {
+        // First status query is where the wait for the driver's compiler threads happens
+        GLint linked = GL_FALSE;
+        glGetProgramiv(p.program, GL_LINK_STATUS, &linked);
+
+        if (!linked) {
+            allOk = false;
+            for (size_t i = 0; i < p.shaders.size(); ++i) {
+                GLint compiled = GL_FALSE;
+                glGetShaderiv(p.shaders[i], GL_COMPILE_STATUS, &compiled);
+                if (compiled) continue;
+                GLint logLen = 0;
+                glGetShaderiv(p.shaders[i], GL_INFO_LOG_LENGTH, &logLen);
+                vector<char> log(max(logLen, 1));
+                glGetShaderInfoLog(p.shaders[i], (GLsizei)log.size(), nullptr, log.data());
+                cerr << "Shader compilation failed (" << p.labels[i] << "):\n" << log.data() << endl;
+            }
+            GLint logLen = 0;
+            glGetProgramiv(p.program, GL_INFO_LOG_LENGTH, &logLen);
+            vector<char> log(max(logLen, 1));
+            glGetProgramInfoLog(p.program, (GLsizei)log.size(), nullptr, log.data());
+            cerr << "Shader linking failed:\n" << log.data() << endl;
+        } else if (binariesSupported) {
+            storeBinary(p.program, p.hash);
+        }
+
+        for (GLuint shader : p.shaders) {
+            glDetachShader(p.program, shader);
+            glDeleteShader(shader);
+        }
+    }
+    pending.clear();
+    return allOk;
+}
+
+bool ShaderCache::loadBinary(GLuint program, uint64_t hash) {
+    ifstream in(pathFor(hash), ios::binary);
+    if (!in) return false;
+
+    CacheHeader header;
+    if (!in.read((char*)&header, sizeof(header))) return false;
+    if (memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.hash != hash) return false;
+
+    vector<char> blob(header.length);
+    if (!in.read(blob.data(), blob.size())) return false;
+
+    glProgramBinary(program, header.format, blob.data(), (GLsizei)blob.size());
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    return linked == GL_TRUE; // a rejected binary leaves the program unlinked, ready for the source path
+}
+
+void ShaderCache::storeBinary(GLuint program, uint64_t hash) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    vector<char> blob(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, nullptr, &format, blob.data());
+
+    CacheHeader header = {};
+    memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.hash = hash;
+    header.format = format;
+    header.length = (uint32_t)length;
+
+    // Write then rename, so a crash mid-write never leaves a truncated entry
+    string path = pathFor(hash);
+    string tmp = path + ".tmp";
+    {
+        ofstream out(tmp, ios::binary | ios::trunc);
+        out.write((const char*)&header, sizeof(header));
+        out.write(blob.data(), blob.size());
+        if (!out) {
+            cerr << "Could not write shader cache entry: " << tmp << endl;
+            return;
+        }
+    }
+    rename(tmp.c_str(), path.c_str());
+}
@@ -0,0 +1,152 @@
+#include "shaderReloader.h"
+#include "shaderCache.h"
+
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static string baseName(const string& path) {
+    size_t slash = path.find_last_of('/');
+    return slash == string::npos ? path : path.substr(slash + 1);
+}
+
+ShaderReloader::ShaderReloader(GLFWwindow* mainWindow, string directory) : directory(move(directory)) {
+#ifdef __linux__
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    // Editors either rewrite in place (close-after-write) or write a temp file and rename it over
+    if (inotifyFd < 0 || inotify_add_watch(inotifyFd, this->directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        cerr << "Shader hot-reload disabled: cannot watch " << this->directory << endl;
+        if (inotifyFd >= 0) close(inotifyFd);
+        inotifyFd = -1;
+        return;
+    }
+
+    // GLFW only creates windows on the main thread; the worker just makes this one current
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    context = glfwCreateWindow(1, 1, "", nullptr, mainWindow);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+    if (!context) {
+        cerr << "Shader hot-reload disabled: cannot create a shared context" << endl;
+        close(inotifyFd);
+        inotifyFd = -1;
+        return;
+    }
+    glfwMakeContextCurrent(mainWindow);
+
+    worker = thread(&ShaderReloader::run, this);
+#else
+    (void)mainWindow;
+#endif
+}
+
+ShaderReloader::~ShaderReloader() {
+    stopping.store(true);
+    if (worker.joinable()) worker.join();
+#ifdef __linux__
+    if (inotifyFd >= 0) close(inotifyFd);
+#endif
+    if (context) glfwDestroyWindow(context);
+
+    // Programs built but never applied
+    for (const auto& r : ready) glDeleteProgram(r.program);
+}
+
+void ShaderReloader::watch(GLuint* program, vector<ShaderFile> files) {
+    lock_guard<mutex> lock(mtx);
+    watched.push_back({ program, move(files) });
+}
+
+void ShaderReloader::apply() {
+    lock_guard<mutex> lock(mtx);
+    for (const auto& r : ready) {
+        GLuint* slot = watched[r.index].program;
+        glDeleteProgram(*slot);
+        *slot = r.program;
+    }
+    ready.clear();
+}
+
+void ShaderReloader::run() {
+#ifdef __linux__
+    glfwMakeContextCurrent(context);
+
+    alignas(inotify_event) char buf[4096];
+    while (!stopping.load()) {
+        pollfd pfd = { inotifyFd, POLLIN, 0 };
+        if (poll(&pfd, 1, 100) <= 0) continue;
+
+        // Coalesce the burst of events a single save produces, then rebuild once
+        set<string> changed;
+        do {
+            ssize_t len;
+            while ((len = read(inotifyFd, buf, sizeof(buf))) > 0) {
+                for (char* p = buf; p < buf + len;) {
+                    auto* ev = (inotify_event*)p;
+                    if (ev->len) changed.insert(ev->name);
+                    p += sizeof(inotify_event) + ev->len;
+                }
+            }
+        } while (poll(&pfd, 1, 50) > 0);
+
+        size_t count;
+        {
+            lock_guard<mutex> lock(mtx);
+            count = watched.size();
+        }
+        for (size_t i = 0; i < count; ++i) {
+            bool affected = false;
+            {
+                lock_guard<mutex> lock(mtx);
+                for (const auto& f : watched[i].files) affected |= changed.count(baseName(f.path)) > 0;
+            }
+            if (affected) rebuild(i);
+        }
+    }
+
+    glfwMakeContextCurrent(nullptr);
+#endif
+}
+
+void ShaderReloader::rebuild(size_t index) {
+    vector<ShaderFile> files;
+    {
+        lock_guard<mutex> lock(mtx);
+        files = watched[index].files;
+    }
+
+    vector<ShaderStage> stages;
+    for (const auto& f : files) {
+        ifstream in(f.path, ios::binary);
+        if (!in) {
+            cerr << "Hot-reload: cannot read " << f.path << ", keeping the previous program" << endl;
+            return;
+        }
+        stringstream ss;
+        ss << in.rdbuf();
+        stages.push_back({ f.type, ss.str(), f.path });
+    }
+
+    // Same cache as startup: a successful rebuild is also a warm start next launch
+    ShaderCache cache;
+    GLuint program = cache.request(stages);
+    if (!cache.finish()) {
+        glDeleteProgram(program);
+        cerr << "Hot-reload: keeping the previous program for " << files[0].path << endl;
+        return;
+    }
+    // The render context must see a fully built program before it binds it
+    glFinish();
+
+    lock_guard<mutex> lock(mtx);
+    ready.push_back({ index, program });
+    cout << "Hot-reload: rebuilt " << files[0].path << endl;
+}
@@ -0,0 +1,258 @@
+#include "snapshot.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const size_t SNAPSHOT_ALIGN = 64;
+
+static uint64_t alignUp(uint64_t v) {
+    return (v + SNAPSHOT_ALIGN - 1) & ~uint64_t(SNAPSHOT_ALIGN - 1);
+}
+
+static size_t fieldBytes(uint32_t f) {
+    return f == SNAP_PARENT ? sizeof(int32_t) : f == SNAP_MERGED ? sizeof(uint8_t) : sizeof(double);
+}
+
+static double wallSeconds() {
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+SnapshotView::~SnapshotView() {
+    close();
+}
+
+bool SnapshotView::open(const char* path) {
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        cerr << "Could not open snapshot: " << path << endl;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SnapshotHeader)) {
+        cerr << "Snapshot is truncated: " << path << endl;
+        ::close(fd);
+        return false;
+    }
+
+    void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        cerr << "Could not map snapshot: " << path << endl;
+        return false;
+    }
+    mapping = map;
+    mappingSize = st.st_size;
+
+    const SnapshotHeader* h = (const SnapshotHeader*)map;
+    if (memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+        cerr << "Not a snapshot file: " << path << endl;
+        close();
+        return false;
+    }
+    if (h->version != SNAPSHOT_VERSION || h->headerSize != sizeof(SnapshotHeader)) {
+        cerr << "Unsupported snapshot version " << h->version << ": " << path << endl;
+        close();
+        return false;
+    }
+    if (h->fileSize != mappingSize) {
+        cerr << "Snapshot size mismatch: " << path << endl;
+        close();
+        return false;
+    }
+    for (uint32_t f = 0; f < SNAP_FIELD_COUNT; ++f) {
+        if (h->offsets[f] + h->bodyCount * fieldBytes(f) > mappingSize) {
+            cerr << "Snapshot field out of range: " << path << endl;
+            close();
+            return false;
+        }
+    }
+
+    // Parents must precede their children: the force kernel, drift and reordering index through them.
+    // A merged body rides inside the body that absorbed it, which is never merged itself.
+    const int32_t* parent = (const int32_t*)((const char*)map + h->offsets[SNAP_PARENT]);
+    const uint8_t* merged = (const uint8_t*)map + h->offsets[SNAP_MERGED];
+    for (uint64_t i = 0; i < h->bodyCount; ++i) {
+        bool valid = parent[i] >= -1 && parent[i] < (int64_t)i && merged[i] <= 1;
+        if (valid && merged[i]) valid = parent[i] >= 0 && !merged[parent[i]];
+        if (!valid) {
+            cerr << "Snapshot body " << i << " has invalid parent " << parent[i] << ": " << path << endl;
+            close();
+            return false;
+        }
+    }
+
+    madvise(map, mappingSize, MADV_SEQUENTIAL);
+    header = h;
+    return true;
+}
+
+void SnapshotView::close() {
+    if (mapping) munmap(mapping, mappingSize);
+    mapping = nullptr;
+    mappingSize = 0;
+    header = nullptr;
+}
+
+const double* SnapshotView::field(SnapshotField f) const {
+    return (const double*)((const char*)mapping + header->offsets[f]);
+}
+
+const int32_t* SnapshotView::parent() const {
+    return (const int32_t*)((const char*)mapping + header->offsets[SNAP_PARENT]);
+}
+
+const uint8_t* SnapshotView::merged() const {
+    return (const uint8_t*)mapping + header->offsets[SNAP_MERGED];
+}
+
+bool saveSnapshot(const char* path, const Bodies& bodies, double time) {
+    const uint64_t n = bodies.size();
+    const vector<double>* columns[] = {
+        &bodies.x, &bodies.y, &bodies.z, &bodies.vx, &bodies.vy, &bodies.vz, &bodies.mass, &bodies.radius
+    };
+
+    SnapshotHeader header = {};
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.headerSize = sizeof(SnapshotHeader);
+    header.bodyCount = n;
+    header.time = time;
+
+    uint64_t offset = alignUp(sizeof(SnapshotHeader));
+    for (uint32_t f = 0; f < SNAP_FIELD_COUNT; ++f) {
+        header.offsets[f] = offset;
+        offset = alignUp(offset + n * fieldBytes(f));
+    }
+    header.fileSize = offset;
+
+    string tmpPath = string(path) + ".tmp";
+    ofstream out(tmpPath, ios::binary | ios::trunc);
+    if (!out) {
+        cerr << "Could not write snapshot: " << tmpPath << endl;
+        return false;
+    }
+
+    static const char zeros[SNAPSHOT_ALIGN] = {};
+    auto padTo = [&](uint64_t target) {
+        uint64_t pos = (uint64_t)out.tellp();
+        if (target > pos) out.write(zeros, (streamsize)(target - pos));
+    };
+
+    out.write((const char*)&header, sizeof(header));
+    for (uint32_t f = 0; f < SNAP_PARENT; ++f) {
+        padTo(header.offsets[f]);
+        out.write((const char*)columns[f]->data(), (streamsize)(n * sizeof(double)));
+    }
+    padTo(header.offsets[SNAP_PARENT]);
+    static_assert(sizeof(int) == sizeof(int32_t), "parent indices are stored as int32");
+    out.write((const char*)bodies.parent.data(), (streamsize)(n * sizeof(int32_t)));
+    padTo(header.offsets[SNAP_MERGED]);
+    out.write((const char*)bodies.merged.data(), (streamsize)n);
+    padTo(header.fileSize);
+
+    out.close();
+    if (!out) {
+        cerr << "Failed while writing snapshot: " << tmpPath << endl;
+        remove(tmpPath.c_str());
+        return false;
+    }
+    if (rename(tmpPath.c_str(), path) != 0) {
+        cerr << "Could not replace snapshot: " << path << endl;
+        return false;
+    }
+    return true;
+}
+
+bool saveSnapshot(const char* path, const PhysicsEngine& physics) {
+    return saveSnapshot(path, physics.bodies, physics.time);
+}
+
+bool loadSnapshot(const char* path, PhysicsEngine& physics) {
+    SnapshotView view;
+    if (!view.open(path)) return false;
+
+    const size_t n = view.size();
+    Bodies& b = physics.bodies;
+    b.resize(n);
+
+    vector<double>* columns[] = { &b.x, &b.y, &b.z, &b.vx, &b.vy, &b.vz, &b.mass, &b.radius };
+    for (uint32_t f = 0; f < SNAP_PARENT; ++f) {
+        memcpy(columns[f]->data(), view.field((SnapshotField)f), n * sizeof(double));
+    }
+    memcpy(b.parent.data(), view.parent(), n * sizeof(int32_t));
+    memcpy(b.merged.data(), view.merged(), n);
+
+    physics.time = view.time();
+    physics.markBodiesChanged();
+    return true;
+}
+
+Checkpointer::Checkpointer(string path, double intervalSeconds)
+    : path(move(path)), interval(intervalSeconds), lastCheckpoint(wallSeconds()) {
+    worker = thread(&Checkpointer::run, this);
+}
+
+Checkpointer::~Checkpointer() {
+    {
+        lock_guard<mutex> lock(mtx);
+        stopping = true;
+    }
+    cv.notify_one();
+    worker.join();
+}
+
+void Checkpointer::maybeCheckpoint(const PhysicsEngine& physics) {
+    double now = wallSeconds();
+    if (now - lastCheckpoint < interval) return;
+    if (checkpoint(physics)) lastCheckpoint = now;
+}
+
+bool Checkpointer::checkpoint(const PhysicsEngine& physics) {
+    // Never wait on the disk: drop this checkpoint if the last one is still in flight
+    if (writing.load(memory_order_acquire)) return false;
+
+    {
+        lock_guard<mutex> lock(mtx);
+        // Same sizes as last time means assign() reuses the staging storage
+        staging.x = physics.bodies.x;   staging.y = physics.bodies.y;   staging.z = physics.bodies.z;
+        staging.vx = physics.bodies.vx; staging.vy = physics.bodies.vy; staging.vz = physics.bodies.vz;
+        staging.mass = physics.bodies.mass;
+        staging.radius = physics.bodies.radius;
+        staging.parent = physics.bodies.parent;
+        staging.merged = physics.bodies.merged;
+        stagingTime = physics.time;
+        pending = true;
+        writing.store(true, memory_order_release);
+    }
+    cv.notify_one();
+    return true;
+}
+
+void Checkpointer::run() {
+    unique_lock<mutex> lock(mtx);
+    while (true) {
+        cv.wait(lock, [this] { return pending || stopping; });
+        if (pending) {
+            // Safe to read staging unlocked: checkpoint() refuses to touch it while writing is set
+            pending = false;
+            lock.unlock();
+            saveSnapshot(path.c_str(), staging, stagingTime);
+            writing.store(false, memory_order_release);
+            lock.lock();
+        }
+        if (stopping && !pending) break;
+    }
+}
@@ -1,40 +1,101 @@
 #include "rasterEngine.h"
 
-int main() {
+int main(int argc, char** argv) {
     Engine engine;
-    
-    // The Sun 
-    Star* sun = engine.addStar(make_unique<Star>(
-        vec3(0.0f), 1.989e30, 6.96e8, vec3(1.0f, 0.7f, 0.3f), 2.0, vec3(0.0f)
-    ));
-    
-    // Mercury
-    Planet* mercury = engine.addPlanet(5.79e10f,  3.30e23, 2.44e6, vec3(0.7f), 1.24e-6, 47360.0f, 0.1222f);
 
-    // Venus
-    Planet* venus = engine.addPlanet(1.082e11f, 4.87e24, 6.05e6, vec3(0.9f, 0.7f, 0.4f), -2.99e-7, 35020.0f, 0.0592f);
-
-    // Earth
-    Planet* earth = engine.addPlanet(1.496e11f, 5.97e24, 6.37e6, vec3(0.2f, 0.5f, 1.0f), 7.29e-5,  29780.0f, 0.0000f);
-    Satellite* moon = engine.addSatellite(earth, 3.84e8f, 7.34e22, 1.73e6, vec3(0.7f, 0.7f, 0.7f), 0.0f, 1022.0f);
-
-    // Mars
-    Planet* mars = engine.addPlanet(2.279e11f, 6.39e23, 3.39e6, vec3(0.9f, 0.3f, 0.2f), 7.08e-5,  24070.0f, 0.0323f);
-
-    // Jupiter
-    Planet*Jupiter = engine.addPlanet(7.785e11f, 1.89e27, 6.99e7, vec3(0.8f, 0.7f, 0.6f), 1.76e-4,  13070.0f, 0.0227f);
+    // --scenario <file> (repeatable) replaces the default Sun-to-Neptune setup;
+    // --restore <file> resumes a saved run; --checkpoint <file> saves one every minute and on exit;
+    // --trajectory <file> streams every --trajectory-every <n>th step to disk for offline analysis;
+    // --diagnostics <file> logs energy and momentum drift every tick (.json: JSON Lines, else CSV);
+    // --max-step <seconds> splits each physics tick into integrator steps no longer than that;
+    // --softening none|plummer|spline with --softening-length <m> smooths close approaches;
+    // --regularize <m> solves mutually nearest pairs closer than that as exact two-body orbits;
+    // --integrator euler|leapfrog|wh picks the scheme (wh: analytic Kepler drifts, for large steps);
+    // --build-ephemeris <file> integrates --ephemeris-span <seconds> once, fits it and exits;
+    // --ephemeris <file> replays one instead of integrating (arrows scrub, R reverses);
+    // --fixed-step <seconds> makes the run deterministic, --record <log> logs it and
+    // --replay <log> re-runs a log headless, checks it bit for bit and exits
+    vector<string> scenarios;
+    string restorePath, checkpointPath, trajectoryPath, diagnosticsPath, ephemerisPath, buildEphemerisPath, recordPath, replayPath;
+    double ephemerisSpan = 10.0 * 365.25 * 86400.0;
+    uint32_t trajectoryEvery = 1;
+    for (int i = 1; i < argc; i += 2) {
+        string opt = argv[i];
+        if (i + 1 == argc) {
+            cerr << "Missing value for " << opt << endl;
+            return 1;
+        }
+        if (opt == "--scenario") {
+            scenarios.push_back(argv[i + 1]);
+        } else if (opt == "--restore") {
+            restorePath = argv[i + 1];
+        } else if (opt == "--checkpoint") {
+            checkpointPath = argv[i + 1];
+        } else if (opt == "--trajectory") {
+            trajectoryPath = argv[i + 1];
+        } else if (opt == "--diagnostics") {
+            diagnosticsPath = argv[i + 1];
+        } else if (opt == "--trajectory-every") {
+            trajectoryEvery = (uint32_t)max(atoi(argv[i + 1]), 1);
+        } else if (opt == "--max-step") {
+            engine.maxStep = atof(argv[i + 1]);
+        } else if (opt == "--ephemeris") {
+            ephemerisPath = argv[i + 1];
+        } else if (opt == "--build-ephemeris") {
+            buildEphemerisPath = argv[i + 1];
+        } else if (opt == "--ephemeris-span") {
+            ephemerisSpan = atof(argv[i + 1]);
+        } else if (opt == "--fixed-step") {
+            engine.fixedDt = atof(argv[i + 1]);
+        } else if (opt == "--record") {
+            recordPath = argv[i + 1];
+        } else if (opt == "--replay") {
+            replayPath = argv[i + 1];
+        } else if (opt == "--integrator") {
+            string kind = argv[i + 1];
+            if (kind == "euler") engine.physics.integrator = Integrator::SemiImplicitEuler;
+            else if (kind == "leapfrog") engine.physics.integrator = Integrator::Leapfrog;
+            else if (kind == "wh") engine.physics.integrator = Integrator::WisdomHolman;
+            else {
+                cerr << "Unknown integrator: " << kind << endl;
+                return 1;
+            }
+        } else if (opt == "--softening") {
+            string kind = argv[i + 1];
+            if (kind == "none") engine.physics.softening = Softening::None;
+            else if (kind == "plummer") engine.physics.softening = Softening::Plummer;
+            else if (kind == "spline") engine.physics.softening = Softening::Spline;
+            else {
+                cerr << "Unknown softening: " << kind << endl;
+                return 1;
+            }
+        } else if (opt == "--softening-length") {
+            engine.physics.softeningLength = atof(argv[i + 1]);
+        } else if (opt == "--regularize") {
+            engine.physics.regularizationRadius = atof(argv[i + 1]);
+        } else {
+            cerr << "Unknown option: " << opt << endl;
+            return 1;
+        }
+    }
+    if (scenarios.empty()) scenarios.push_back("resources/scenarios/solarSystem.csv");
 
-    // Saturn
-    Planet* Saturn = engine.addPlanet(1.433e12f, 5.68e26, 5.82e7, vec3(0.9f, 0.8f, 0.5f), 1.63e-4,   9680.0f, 0.0435f);
-    engine.addRing(Saturn, 7.0e7, 6.5e7, 0.45, vec3(0.8f, 0.7f, 0.5f));
+    for (const auto& path : scenarios) {
+        if (!engine.loadScenario(path.c_str())) return 1;
+    }
 
-    // Uranus
-    Planet* Uranus = engine.addPlanet(2.871e12f, 8.68e25, 2.53e7, vec3(0.6f, 0.8f, 0.9f), -1.04e-4,  6800.0f, 0.0134f);
+    engine.setSimulation();
 
-    // Neptune
-    Planet* neptune = engine.addPlanet(4.495e12f, 1.02e26, 2.46e7, vec3(0.3f, 0.5f, 0.9f), 1.08e-4,   5430.0f, 0.0309f);
+    if (!restorePath.empty() && !engine.loadSnapshot(restorePath.c_str())) return 1;
+    if (!checkpointPath.empty() && !engine.enableCheckpoints(checkpointPath, 60.0)) return 1;
+    if (!trajectoryPath.empty() && !engine.enableTrajectory(trajectoryPath, trajectoryEvery)) return 1;
+    if (!diagnosticsPath.empty() && !engine.enableDiagnostics(diagnosticsPath)) return 1;
 
-    engine.setSimulation();
+    // Four-day segments keep the Moon's orbit well inside the fit
+    if (!buildEphemerisPath.empty()) return engine.buildEphemeris(buildEphemerisPath, ephemerisSpan, 4.0 * 86400.0) ? 0 : 1;
+    if (!ephemerisPath.empty() && !engine.playEphemeris(ephemerisPath)) return 1;
+    if (!replayPath.empty()) return engine.replayEvents(replayPath) ? 0 : 1;
+    if (!recordPath.empty() && !engine.recordEvents(recordPath)) return 1;
 
     while (engine.run()) {
         static bool tabPressed = false;
@@ -47,8 +108,20 @@ int main() {
             tabPressed = false;
         }
 
+        if (engine.isPlayingBack()) {
+            static bool reversePressed = false;
+            bool reverse = glfwGetKey(engine.window, GLFW_KEY_R) == GLFW_PRESS;
+            if (reverse && !reversePressed) engine.timeScale = -engine.timeScale;
+            reversePressed = reverse;
+
+            // Holding an arrow scrubs at ten times the playback rate
+            float scrub = 10.0f * fabs(engine.deltaTime);
+            if (glfwGetKey(engine.window, GLFW_KEY_RIGHT) == GLFW_PRESS) engine.scrub(scrub);
+            if (glfwGetKey(engine.window, GLFW_KEY_LEFT) == GLFW_PRESS) engine.scrub(-scrub);
+        }
+
         engine.updateCameraFocus();
     };
 
     return 0;
-}
\ No newline at end of file
+}
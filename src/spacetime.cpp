@@ -0,0 +1,265 @@
+#include "spacetime.h"
+
+#include "scenario.h"
+
+#include <algorithm>
+#include <cmath>
+
+void displaceGrid(const ObjectData* objs, size_t count, int gridSize, float spacing, vec3* out) {
+    const int row = gridSize + 1;
+    const float rsPerKg = schwarzschildPerKg();
+
+    #pragma omp parallel for schedule(static)
+    for (int z = 0; z <= gridSize; ++z) {
+        float worldZ = (z - gridSize / 2) * spacing;
+        vec3* v = out + size_t(z) * row;
+
+        #pragma omp simd
+        for (int x = 0; x <= gridSize; ++x) {
+            float worldX = (x - gridSize / 2) * spacing;
+            float y = 0.0f;
+            for (size_t k = 0; k < count; ++k) {
+                float r_s = rsPerKg * objs[k].mass;
+                float dx = worldX - objs[k].posRadius.x;
+                float dz = worldZ - objs[k].posRadius.z;
+                float dist = std::sqrt(dx * dx + dz * dz);
+                // Flamm's paraboloid outside r_s, a flat pit inside it
+                float deltaY = dist > r_s ? 2.0f * std::sqrt(r_s * (dist - r_s)) : 2.0f * r_s;
+                y += deltaY - 3e10f;
+            }
+            v[x] = vec3(worldX, y, worldZ);
+        }
+    }
+}
+
+void ObjectGrid::build(const ObjectData* objs, size_t count) {
+    cellStart.clear();
+    cellObjects.clear();
+    if (count == 0) {
+        // One empty unit cell: the shader divides by the cell size before it looks at the range
+        origin = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        dims = ivec4(1, 1, 1, 1);
+        bounds = vec4(0.0f);
+        cellStart.assign(2, 0);
+        return;
+    }
+
+    vec3 lo = vec3(objs[0].posRadius) - vec3(objs[0].posRadius.w);
+    vec3 hi = vec3(objs[0].posRadius) + vec3(objs[0].posRadius.w);
+    for (size_t i = 1; i < count; ++i) {
+        vec3 p = vec3(objs[i].posRadius);
+        float r = objs[i].posRadius.w;
+        lo = min(lo, p - vec3(r));
+        hi = max(hi, p + vec3(r));
+    }
+
+    // Bounding sphere around every object, used as a cheap per-step reject
+    vec3 center = (lo + hi) * 0.5f;
+    float boundRadius = 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        float d = length(vec3(objs[i].posRadius) - center) + objs[i].posRadius.w;
+        boundRadius = std::max(boundRadius, d);
+    }
+
+    // Cubic cells sized so that an evenly spread scene lands about one object per cell
+    vec3 extent = hi - lo;
+    float maxExtent = std::max(extent.x, std::max(extent.y, extent.z));
+    int cellsPerAxis = glm::clamp((int)std::ceil(std::cbrt((double)count)), 1, 64);
+    float cellSize = std::max(maxExtent / cellsPerAxis, 1.0f);
+    ivec3 n(
+        glm::clamp((int)std::ceil(extent.x / cellSize), 1, 64),
+        glm::clamp((int)std::ceil(extent.y / cellSize), 1, 64),
+        glm::clamp((int)std::ceil(extent.z / cellSize), 1, 64)
+    );
+    int numCells = n.x * n.y * n.z;
+
+    origin = vec4(lo, cellSize);
+    dims = ivec4(n.x, n.y, n.z, numCells);
+    bounds = vec4(center, boundRadius);
+
+    auto cellRange = [&](size_t i, ivec3& c0, ivec3& c1) {
+        vec3 p = vec3(objs[i].posRadius);
+        float r = objs[i].posRadius.w;
+        vec3 a = (p - vec3(r) - lo) / cellSize;
+        vec3 b = (p + vec3(r) - lo) / cellSize;
+        c0 = ivec3(glm::clamp((int)std::floor(a.x), 0, n.x - 1),
+                   glm::clamp((int)std::floor(a.y), 0, n.y - 1),
+                   glm::clamp((int)std::floor(a.z), 0, n.z - 1));
+        c1 = ivec3(glm::clamp((int)std::floor(b.x), 0, n.x - 1),
+                   glm::clamp((int)std::floor(b.y), 0, n.y - 1),
+                   glm::clamp((int)std::floor(b.z), 0, n.z - 1));
+    };
+
+    // Counting sort of (cell, object) pairs; objects stay in index order within a cell
+    cellStart.assign(numCells + 1, 0);
+    ivec3 c0, c1;
+    for (size_t i = 0; i < count; ++i) {
+        cellRange(i, c0, c1);
+        for (int z = c0.z; z <= c1.z; ++z)
+            for (int y = c0.y; y <= c1.y; ++y)
+                for (int x = c0.x; x <= c1.x; ++x)
+                    cellStart[(z * n.y + y) * n.x + x + 1]++;
+    }
+    for (int i = 0; i < numCells; ++i) cellStart[i + 1] += cellStart[i];
+
+    cellObjects.resize(cellStart[numCells]);
+    std::vector<uint32_t> fill(cellStart.begin(), cellStart.end() - 1);
+    for (size_t i = 0; i < count; ++i) {
+        cellRange(i, c0, c1);
+        for (int z = c0.z; z <= c1.z; ++z)
+            for (int y = c0.y; y <= c1.y; ++y)
+                for (int x = c0.x; x <= c1.x; ++x)
+                    cellObjects[fill[(z * n.y + y) * n.x + x]++] = (uint32_t)i;
+    }
+}
+
+bool loadObjects(const char* path, std::vector<ObjectData>& objs) {
+    objs.clear();
+    objs.reserve(countScenarioRecords(path));
+    return readScenario(path, [&](const ScenarioBody& rec) {
+        if (rec.kind != "object") return;
+        double pos[3], vel[3];
+        scenarioState(rec, pos, vel);
+        objs.push_back({
+            vec4((float)pos[0], (float)pos[1], (float)pos[2], (float)rec.radius),
+            vec4((float)rec.r, (float)rec.g, (float)rec.b, 1.0f),
+            vec3((float)vel[0], (float)vel[1], (float)vel[2]),
+            (float)rec.mass
+        });
+    });
+}
+
+void objectsToBodies(const std::vector<ObjectData>& objs, Bodies& bodies) {
+    bodies.clear();
+    bodies.reserve(objs.size());
+    for (const auto& obj : objs) {
+        bodies.add(obj.posRadius.x, obj.posRadius.y, obj.posRadius.z,
+                   obj.velocity.x, obj.velocity.y, obj.velocity.z,
+                   obj.mass, obj.posRadius.w);
+    }
+}
+
+void bodiesToObjects(const Bodies& bodies, std::vector<ObjectData>& objs) {
+    size_t n = std::min(bodies.size(), objs.size());
+    for (size_t i = 0; i < n; ++i) {
+        objs[i].posRadius.x = (float)bodies.x[i];
+        objs[i].posRadius.y = (float)bodies.y[i];
+        objs[i].posRadius.z = (float)bodies.z[i];
+        objs[i].velocity = vec3((float)bodies.vx[i], (float)bodies.vy[i], (float)bodies.vz[i]);
+    }
+}
+
+namespace {
+
+struct GeodesicRay {
+    float x, y, z, r, theta, phi;
+    float dr, dtheta, dphi;
+    float E, L;
+};
+
+GeodesicRay initRay(vec3 pos, vec3 dir) {
+    GeodesicRay ray;
+    ray.x = pos.x; ray.y = pos.y; ray.z = pos.z;
+    ray.r = length(pos);
+    ray.theta = std::acos(pos.z / ray.r);
+    ray.phi = std::atan2(pos.y, pos.x);
+
+    float st = std::sin(ray.theta), ct = std::cos(ray.theta);
+    float sp = std::sin(ray.phi), cp = std::cos(ray.phi);
+    ray.dr     = st * cp * dir.x + st * sp * dir.y + ct * dir.z;
+    ray.dtheta = (ct * cp * dir.x + ct * sp * dir.y - st * dir.z) / ray.r;
+    ray.dphi   = (-sp * dir.x + cp * dir.y) / (ray.r * st);
+
+    ray.L = ray.r * ray.r * st * ray.dphi;
+    float f = 1.0f - GEODESIC_RS / ray.r;
+    float dt_dL = std::sqrt((ray.dr * ray.dr) / f + ray.r * ray.r * (ray.dtheta * ray.dtheta + st * st * ray.dphi * ray.dphi));
+    ray.E = f * dt_dL;
+    return ray;
+}
+
+void geodesicStep(GeodesicRay& ray, float dL) {
+    float r = ray.r, theta = ray.theta;
+    float dr = ray.dr, dtheta = ray.dtheta, dphi = ray.dphi;
+    float f = 1.0f - GEODESIC_RS / r;
+    float dt_dL = ray.E / f;
+    float st = std::sin(theta), ct = std::cos(theta);
+
+    float d2r = -(GEODESIC_RS / (2.0f * r * r)) * f * dt_dL * dt_dL
+              + (GEODESIC_RS / (2.0f * r * r * f)) * dr * dr
+              + r * (dtheta * dtheta + st * st * dphi * dphi);
+    float d2theta = -2.0f * dr * dtheta / r + st * ct * dphi * dphi;
+    float d2phi = -2.0f * dr * dphi / r - 2.0f * ct / st * dtheta * dphi;
+
+    ray.r      += dL * dr;
+    ray.theta  += dL * dtheta;
+    ray.phi    += dL * dphi;
+    ray.dr     += dL * d2r;
+    ray.dtheta += dL * d2theta;
+    ray.dphi   += dL * d2phi;
+
+    ray.x = ray.r * std::sin(ray.theta) * std::cos(ray.phi);
+    ray.y = ray.r * std::sin(ray.theta) * std::sin(ray.phi);
+    ray.z = ray.r * std::cos(ray.theta);
+}
+
+const ObjectData* hitObject(vec3 P, const ObjectData* objs, const ObjectGrid& grid) {
+    vec3 toBounds = P - vec3(grid.bounds);
+    if (dot(toBounds, toBounds) > grid.bounds.w * grid.bounds.w) return nullptr;
+
+    int cx = (int)std::floor((P.x - grid.origin.x) / grid.origin.w);
+    int cy = (int)std::floor((P.y - grid.origin.y) / grid.origin.w);
+    int cz = (int)std::floor((P.z - grid.origin.z) / grid.origin.w);
+    if (cx < 0 || cy < 0 || cz < 0 || cx >= grid.dims.x || cy >= grid.dims.y || cz >= grid.dims.z) return nullptr;
+
+    int c = (cz * grid.dims.y + cy) * grid.dims.x + cx;
+    for (uint32_t k = grid.cellStart[c]; k < grid.cellStart[c + 1]; ++k) {
+        const ObjectData& obj = objs[grid.cellObjects[k]];
+        if (distance(P, vec3(obj.posRadius)) <= obj.posRadius.w) return &obj;
+    }
+    return nullptr;
+}
+
+} // namespace
+
+void traceGeodesics(const GeodesicCamera& cam, const GeodesicDisk& disk,
+                    const ObjectData* objs, const ObjectGrid& grid,
+                    int width, int height, int maxSteps, vec4* out) {
+    const double escapeR = 1e30;
+
+    // Rays near the hole take far longer than rays that escape, so hand out rows dynamically
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int py = 0; py < height; ++py) {
+        for (int px = 0; px < width; ++px) {
+            float u = (2.0f * (px + 0.5f) / width - 1.0f) * cam.aspect * cam.tanHalfFov;
+            float v = (1.0f - 2.0f * (py + 0.5f) / height) * cam.tanHalfFov;
+            vec3 dir = normalize(u * cam.right - v * cam.up + cam.forward);
+            GeodesicRay ray = initRay(cam.pos, dir);
+
+            vec4 color(0.0f);
+            vec3 prevPos(ray.x, ray.y, ray.z);
+            for (int i = 0; i < maxSteps; ++i) {
+                if (ray.r <= GEODESIC_RS) { color = vec4(0.0f, 0.0f, 0.0f, 1.0f); break; }
+                geodesicStep(ray, GEODESIC_DLAMBDA);
+
+                vec3 newPos(ray.x, ray.y, ray.z);
+                float rDisk = std::sqrt(newPos.x * newPos.x + newPos.z * newPos.z);
+                if (prevPos.y * newPos.y < 0.0f && rDisk >= disk.r1 && rDisk <= disk.r2) {
+                    float r = length(newPos) / disk.r2;
+                    color = vec4(1.0f, r, 0.2f, r);
+                    break;
+                }
+                if (const ObjectData* obj = hitObject(newPos, objs, grid)) {
+                    vec3 N = normalize(newPos - vec3(obj->posRadius));
+                    vec3 V = normalize(cam.pos - newPos);
+                    float ambient = 0.1f;
+                    float intensity = ambient + (1.0f - ambient) * std::max(dot(N, V), 0.0f);
+                    color = vec4(vec3(obj->color) * intensity, obj->color.a);
+                    break;
+                }
+                prevPos = newPos;
+                if (ray.r > escapeR) break;
+            }
+            out[size_t(py) * width + px] = color;
+        }
+    }
+}
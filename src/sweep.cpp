@@ -0,0 +1,249 @@
+// Headless parameter sweeps: every combination of the given values runs as its own simulation,
+// one per core, and each run's conservation and stability metrics go to a CSV row.
+//
+//   ./sweep.bash --scale Jupiter.mass=0.5,1,2 --scale Earth.orbitVel=0.95,1,1.05 --out build/sweep.csv
+//   ./sweep.bash --dt 3600,86400 --span 3.156e9 --integrator wh
+//
+// --scale <name>.<mass|radius|orbitVel|distance>=<factors> multiplies a scenario record's field
+// (an unknown name is an error);
+// --dt <seconds,...> is the integrator step (the headless stand-in for timeScale);
+// --span <seconds> is the simulated duration of every run; --integrator euler|leapfrog|wh;
+// --scenario <file> replaces the default solar system; --collisions turns merging on.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <omp.h>
+
+#include "physicsEngine.h"
+#include "scenario.h"
+
+using namespace std;
+
+struct Axis {
+    string label;  // CSV column, e.g. "Jupiter.mass" or "dt"
+    string body;   // empty for dt
+    string field;
+    vector<double> values;
+};
+
+struct RunResult {
+    vector<double> params;
+    uint64_t steps = 0;
+    double wallSeconds = 0.0;
+    double energyError = 0.0, maxEnergyError = 0.0, angularMomentumError = 0.0;
+    size_t merges = 0, unbound = 0;
+    bool ok = true;
+};
+
+// Top-level bodies with positive two-body energy about the most massive one
+static size_t countUnbound(const Bodies& b, double G) {
+    size_t c = 0;
+    for (size_t i = 1; i < b.size(); ++i) {
+        if (b.mass[i] > b.mass[c] && b.parent[i] < 0) c = i;
+    }
+    size_t count = 0;
+    for (size_t i = 0; i < b.size(); ++i) {
+        if (i == c || b.parent[i] >= 0 || b.absorbed(i)) continue;
+        double dx = b.x[i] - b.x[c], dy = b.y[i] - b.y[c], dz = b.z[i] - b.z[c];
+        double dvx = b.vx[i] - b.vx[c], dvy = b.vy[i] - b.vy[c], dvz = b.vz[i] - b.vz[c];
+        double e = 0.5 * (dvx * dvx + dvy * dvy + dvz * dvz) - G * (b.mass[c] + b.mass[i]) / sqrt(dx * dx + dy * dy + dz * dz);
+        if (e > 0.0) ++count;
+    }
+    return count;
+}
+
+static bool parseList(const string& text, vector<double>& out) {
+    stringstream in(text);
+    string item;
+    while (getline(in, item, ',')) {
+        char* end = nullptr;
+        double v = strtod(item.c_str(), &end);
+        if (end == item.c_str() || *end != '\0') return false;
+        out.push_back(v);
+    }
+    return !out.empty();
+}
+
+int main(int argc, char** argv) {
+    string scenarioPath = "resources/scenarios/solarSystem.csv", outPath;
+    double span = 100.0 * 365.25 * 86400.0;
+    Integrator integrator = Integrator::Leapfrog;
+    bool collisions = false;
+    vector<Axis> axes;
+    Axis dtAxis{ "dt", "", "", {} };
+
+    for (int i = 1; i < argc; ++i) {
+        string opt = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (opt == "--collisions") {
+            collisions = true;
+        } else if (opt == "--scale" && hasValue) {
+            string spec = argv[++i];
+            size_t dot = spec.find('.'), eq = spec.find('=');
+            Axis axis;
+            if (dot == string::npos || eq == string::npos || eq < dot || !parseList(spec.substr(eq + 1), axis.values)) {
+                cerr << "Expected --scale <name>.<field>=<v1>,<v2>,...: " << spec << endl;
+                return 1;
+            }
+            axis.body = spec.substr(0, dot);
+            axis.field = spec.substr(dot + 1, eq - dot - 1);
+            axis.label = spec.substr(0, eq);
+            if (axis.field != "mass" && axis.field != "radius" && axis.field != "orbitVel" && axis.field != "distance") {
+                cerr << "Unknown field: " << axis.field << endl;
+                return 1;
+            }
+            axes.push_back(axis);
+        } else if (opt == "--dt" && hasValue) {
+            if (!parseList(argv[++i], dtAxis.values)) {
+                cerr << "Expected --dt <seconds>,..." << endl;
+                return 1;
+            }
+        } else if (opt == "--span" && hasValue) {
+            span = atof(argv[++i]);
+        } else if (opt == "--scenario" && hasValue) {
+            scenarioPath = argv[++i];
+        } else if (opt == "--out" && hasValue) {
+            outPath = argv[++i];
+        } else if (opt == "--integrator" && hasValue) {
+            string kind = argv[++i];
+            if (kind == "euler") integrator = Integrator::SemiImplicitEuler;
+            else if (kind == "leapfrog") integrator = Integrator::Leapfrog;
+            else if (kind == "wh") integrator = Integrator::WisdomHolman;
+            else {
+                cerr << "Unknown integrator: " << kind << endl;
+                return 1;
+            }
+        } else {
+            cerr << "Unknown option: " << opt << endl;
+            return 1;
+        }
+    }
+    if (dtAxis.values.empty()) dtAxis.values.push_back(86400.0);
+    axes.push_back(dtAxis);
+
+    // A misspelt name would otherwise give every run the same unscaled scenario
+    {
+        vector<bool> matched(axes.size() - 1, false);
+        Bodies probe;
+        bool loaded = loadScenarioBodies(scenarioPath.c_str(), probe, [&](ScenarioBody& rec) {
+            for (size_t k = 0; k < matched.size(); ++k) {
+                if (rec.name == axes[k].body) matched[k] = true;
+            }
+        });
+        if (!loaded) return 1;
+        for (size_t k = 0; k < matched.size(); ++k) {
+            if (!matched[k]) {
+                cerr << "--scale " << axes[k].label << ": no record named '" << axes[k].body << "' in " << scenarioPath << endl;
+                return 1;
+            }
+        }
+    }
+
+    size_t runs = 1;
+    for (const Axis& a : axes) runs *= a.values.size();
+
+    // One simulation per core: the force pass inside each run stays on its thread
+    omp_set_max_active_levels(1);
+    vector<RunResult> results(runs);
+    auto start = chrono::steady_clock::now();
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (long r = 0; r < (long)runs; ++r) {
+        RunResult& result = results[r];
+        size_t rest = (size_t)r;
+        for (const Axis& a : axes) {
+            result.params.push_back(a.values[rest % a.values.size()]);
+            rest /= a.values.size();
+        }
+        double dt = result.params.back();
+
+        PhysicsEngine physics;
+        physics.minDistance = 1e5;
+        physics.integrator = integrator;
+        physics.collisions = collisions;
+        result.ok = loadScenarioBodies(scenarioPath.c_str(), physics.bodies, [&](ScenarioBody& rec) {
+            for (size_t k = 0; k + 1 < axes.size(); ++k) {
+                const Axis& a = axes[k];
+                if (rec.name != a.body) continue;
+                double f = result.params[k];
+                if (a.field == "mass") rec.mass *= f;
+                else if (a.field == "radius") rec.radius *= f;
+                else if (a.field == "orbitVel") {
+                    rec.orbitVel *= f;
+                    rec.vx *= f; rec.vy *= f; rec.vz *= f;
+                } else if (a.field == "distance") {
+                    rec.distance *= f;
+                    rec.x *= f; rec.y *= f; rec.z *= f;
+                }
+            }
+        });
+        if (!result.ok) continue;
+
+        // The force pass measures energy and momentum as it goes, so every step is sampled
+        physics.diagnostics = true;
+        physics.computeAccelerations();
+        const Diagnostics initial = physics.metrics;
+        const double e0 = initial.energy();
+        const double* L0 = initial.angularMomentum;
+        auto runStart = chrono::steady_clock::now();
+
+        uint64_t steps = (uint64_t)ceil(span / dt);
+        size_t merges = 0;
+        for (uint64_t k = 1; k <= steps; ++k) {
+            physics.step(dt);
+            // Absorbed bodies would otherwise stay in every pair loop for the rest of the run
+            if (physics.mergeCount != merges) {
+                physics.compact();
+                merges = physics.mergeCount;
+            }
+            // Semi-implicit Euler measures where its step starts; one more pass brings it to the end
+            if (k == steps && physics.integrator == Integrator::SemiImplicitEuler) physics.computeAccelerations();
+            const Diagnostics& d = physics.metrics;
+            result.energyError = fabs((d.energy() - e0) / e0);
+            result.maxEnergyError = max(result.maxEnergyError, result.energyError);
+        }
+        const double* L = physics.metrics.angularMomentum;
+        double dL = sqrt((L[0] - L0[0]) * (L[0] - L0[0]) + (L[1] - L0[1]) * (L[1] - L0[1]) + (L[2] - L0[2]) * (L[2] - L0[2]));
+        result.angularMomentumError = dL / max(sqrt(L0[0] * L0[0] + L0[1] * L0[1] + L0[2] * L0[2]), 1e-300);
+        result.steps = steps;
+        result.wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - runStart).count();
+        result.merges = physics.mergeCount;
+        result.unbound = countUnbound(physics.bodies, physics.gravConst);
+    }
+    double wall = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    FILE* out = outPath.empty() ? stdout : fopen(outPath.c_str(), "w");
+    if (!out) {
+        cerr << "Could not write " << outPath << endl;
+        return 1;
+    }
+    fprintf(out, "run");
+    for (const Axis& a : axes) fprintf(out, ",%s", a.label.c_str());
+    fprintf(out, ",steps,wallSeconds,energyError,maxEnergyError,angularMomentumError,merges,unbound\n");
+    uint64_t totalSteps = 0;
+    size_t failed = 0;
+    for (size_t r = 0; r < runs; ++r) {
+        const RunResult& res = results[r];
+        if (!res.ok) {
+            ++failed;
+            continue;
+        }
+        totalSteps += res.steps;
+        fprintf(out, "%zu", r);
+        for (double p : res.params) fprintf(out, ",%.9g", p);
+        fprintf(out, ",%llu,%.4f,%.6e,%.6e,%.6e,%zu,%zu\n", (unsigned long long)res.steps, res.wallSeconds,
+                res.energyError, res.maxEnergyError, res.angularMomentumError, res.merges, res.unbound);
+    }
+    if (out != stdout) fclose(out);
+
+    fprintf(stderr, "%zu runs on %d threads in %.2f s: %.0f simulations/hour, %.3g steps/s\n",
+            runs - failed, omp_get_max_threads(), wall, (runs - failed) * 3600.0 / max(wall, 1e-9), totalSteps / max(wall, 1e-9));
+    return failed == 0 ? 0 : 1;
+}
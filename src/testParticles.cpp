@@ -0,0 +1,107 @@
+#include "testParticles.h"
+#include "physicsEngine.h"
+#include "profiler.h"
+
+#include <cmath>
+#include <random>
+
+void TestParticles::reserve(size_t n) {
+    for (auto* v : { &x, &y, &z, &vx, &vy, &vz, &ax, &ay, &az }) v->reserve(n);
+}
+
+void TestParticles::clear() {
+    for (auto* v : { &x, &y, &z, &vx, &vy, &vz, &ax, &ay, &az }) v->clear();
+    accelerationsValid = false;
+}
+
+size_t TestParticles::add(double px, double py, double pz, double velX, double velY, double velZ) {
+    x.push_back(px); y.push_back(py); z.push_back(pz);
+    vx.push_back(velX); vy.push_back(velY); vz.push_back(velZ);
+    ax.push_back(0.0); ay.push_back(0.0); az.push_back(0.0);
+    accelerationsValid = false;
+    return x.size() - 1;
+}
+
+void TestParticles::accelerate(const double* sx, const double* sy, const double* sz, const double* gm, size_t n, double minDistance) {
+    PROFILE_ZONE("particle forces");
+    const long count = (long)size();
+    const long sources = (long)n;
+    const double minDist2 = minDistance * minDistance;
+    const double* px = x.data();
+    const double* py = y.data();
+    const double* pz = z.data();
+    double* pax = ax.data();
+    double* pay = ay.data();
+    double* paz = az.data();
+
+    // Vectorized across particles: every lane walks the same short list of sources
+    #pragma omp parallel for simd schedule(static)
+    for (long i = 0; i < count; ++i) {
+        double xi = px[i], yi = py[i], zi = pz[i];
+        double axi = 0.0, ayi = 0.0, azi = 0.0;
+        for (long j = 0; j < sources; ++j) {
+            double dx = sx[j] - xi;
+            double dy = sy[j] - yi;
+            double dz = sz[j] - zi;
+            double r2 = dx * dx + dy * dy + dz * dz;
+            double s = r2 > minDist2 ? gm[j] / (r2 * std::sqrt(r2)) : 0.0;
+            axi += dx * s;
+            ayi += dy * s;
+            azi += dz * s;
+        }
+        pax[i] = axi;
+        pay[i] = ayi;
+        paz[i] = azi;
+    }
+    accelerationsValid = true;
+}
+
+void TestParticles::kick(double dt) {
+    const long count = (long)size();
+    #pragma omp parallel for simd schedule(static)
+    for (long i = 0; i < count; ++i) {
+        vx[i] += ax[i] * dt;
+        vy[i] += ay[i] * dt;
+        vz[i] += az[i] * dt;
+    }
+}
+
+void TestParticles::drift(double dt) {
+    const long count = (long)size();
+    #pragma omp parallel for simd schedule(static)
+    for (long i = 0; i < count; ++i) {
+        x[i] += vx[i] * dt;
+        y[i] += vy[i] * dt;
+        z[i] += vz[i] * dt;
+    }
+}
+
+size_t addParticleDisc(TestParticles& particles, const Bodies& bodies, double gravConst, const ParticleDisc& disc) {
+    size_t first = particles.size();
+    if (disc.host >= bodies.size() || disc.count == 0) return first;
+
+    const size_t h = disc.host;
+    const double mu = gravConst * bodies.mass[h];
+    const double ci = std::cos(disc.inclination), si = std::sin(disc.inclination);
+    std::mt19937_64 rng(disc.seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0), angle(0.0, 2.0 * M_PI);
+    std::normal_distribution<double> jitter(0.0, disc.scatter);
+
+    particles.reserve(first + disc.count);
+    for (size_t k = 0; k < disc.count; ++k) {
+        double r = std::sqrt(disc.inner * disc.inner + unit(rng) * (disc.outer * disc.outer - disc.inner * disc.inner));
+        double a = angle(rng);
+        double v = std::sqrt(mu / r);
+
+        // Prograde in the xz plane like Engine::addPlanet, with a little random eccentricity and tilt
+        double c = std::cos(a), s = std::sin(a);
+        double vr = v * jitter(rng), vn = v * jitter(rng);
+        double px = r * c, pz = -r * s;
+        double qx = v * s + vr * c, qy = vn, qz = v * c - vr * s;
+
+        // Tilt about the x axis
+        particles.add(bodies.x[h] + px, bodies.y[h] - pz * si, bodies.z[h] + pz * ci,
+                      bodies.vx[h] + qx, bodies.vy[h] + qy * ci - qz * si, bodies.vz[h] + qy * si + qz * ci);
+    }
+    return first;
+}
@@ -0,0 +1,209 @@
+#include "trajectory.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include <zlib.h>
+
+using namespace std;
+
+// Groups byte k of every double together; positions and velocities share exponents and
+// leading mantissa bytes from one body and frame to the next, which zlib then squeezes out.
+static void shuffleBytes(const double* in, size_t count, unsigned char* out) {
+    const unsigned char* bytes = (const unsigned char*)in;
+    for (size_t b = 0; b < sizeof(double); ++b) {
+        unsigned char* dst = out + b * count;
+        for (size_t i = 0; i < count; ++i) dst[i] = bytes[i * sizeof(double) + b];
+    }
+}
+
+static void unshuffleBytes(const unsigned char* in, size_t count, double* out) {
+    unsigned char* bytes = (unsigned char*)out;
+    for (size_t b = 0; b < sizeof(double); ++b) {
+        const unsigned char* src = in + b * count;
+        for (size_t i = 0; i < count; ++i) bytes[i * sizeof(double) + b] = src[i];
+    }
+}
+
+TrajectoryWriter::TrajectoryWriter(const string& path, size_t bodyCount, uint32_t decimation, size_t memoryBudget)
+    : bodyCount(bodyCount), decimation(max(decimation, 1u)) {
+    out.open(path, ios::binary | ios::trunc);
+    if (!out) {
+        cerr << "Could not open trajectory file: " << path << endl;
+        return;
+    }
+
+    // Half the budget for in-flight frames, half for the chunk being assembled
+    size_t frameBytes = max<size_t>(bodyCount * TRAJECTORY_COLUMNS * sizeof(double), 1);
+    size_t poolFrames = clamp<size_t>(memoryBudget / 2 / frameBytes, 4, 256);
+    framesPerChunk = (uint32_t)clamp<size_t>(memoryBudget / 2 / frameBytes, 1, 256);
+
+    pool.resize(poolFrames);
+    freeFrames.reset(poolFrames);
+    filledFrames.reset(poolFrames);
+    for (auto& frame : pool) {
+        for (auto& col : frame.columns) col.resize(bodyCount);
+        freeFrames.push(&frame);
+    }
+
+    chunkTimes.reserve(framesPerChunk);
+    for (uint32_t c = 0; c < TRAJECTORY_COLUMNS; ++c) {
+        chunkColumns[c].resize(size_t(framesPerChunk) * bodyCount);
+        shuffled[c].resize(chunkColumns[c].size() * sizeof(double));
+        compressed[c].resize(compressBound((uLong)shuffled[c].size()));
+    }
+
+    TrajectoryHeader header = {};
+    memcpy(header.magic, TRAJECTORY_MAGIC, sizeof(TRAJECTORY_MAGIC));
+    header.version = TRAJECTORY_VERSION;
+    header.columnCount = TRAJECTORY_COLUMNS;
+    header.bodyCount = bodyCount;
+    header.decimation = this->decimation;
+    header.framesPerChunk = framesPerChunk;
+    out.write((const char*)&header, sizeof(header));
+
+    opened = true;
+    worker = thread(&TrajectoryWriter::run, this);
+}
+
+TrajectoryWriter::~TrajectoryWriter() {
+    if (!opened) return;
+    stopping.store(true, memory_order_release);
+    worker.join();
+    out.close();
+}
+
+bool TrajectoryWriter::push(const Bodies& bodies, double time) {
+    if (!opened || (pushes++ % decimation) != 0) return true;
+    if (bodies.size() != bodyCount) {
+        // Every later frame would mismatch too; the file stays valid up to here
+        if (!resized) cerr << "Trajectory: body count changed from " << bodyCount << " to " << bodies.size()
+                           << ", recording stopped" << endl;
+        resized = true;
+        return false;
+    }
+
+    Frame* frame;
+    if (!freeFrames.pop(frame)) {
+        dropped.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+
+    const vector<double>* src[TRAJECTORY_COLUMNS] = { &bodies.x, &bodies.y, &bodies.z, &bodies.vx, &bodies.vy, &bodies.vz };
+    for (uint32_t c = 0; c < TRAJECTORY_COLUMNS; ++c) {
+        memcpy(frame->columns[c].data(), src[c]->data(), bodyCount * sizeof(double));
+    }
+    frame->time = time;
+    filledFrames.push(frame);
+    return true;
+}
+
+void TrajectoryWriter::run() {
+    while (true) {
+        Frame* frame;
+        if (!filledFrames.pop(frame)) {
+            if (stopping.load(memory_order_acquire)) {
+                // The producer has stopped; anything still queued was pushed before the flag
+                if (!filledFrames.pop(frame)) break;
+            } else {
+                this_thread::sleep_for(chrono::milliseconds(1));
+                continue;
+            }
+        }
+
+        chunkTimes.push_back(frame->time);
+        size_t offset = size_t(chunkFrames) * bodyCount;
+        for (uint32_t c = 0; c < TRAJECTORY_COLUMNS; ++c) {
+            memcpy(chunkColumns[c].data() + offset, frame->columns[c].data(), bodyCount * sizeof(double));
+        }
+        freeFrames.push(frame);
+
+        if (++chunkFrames == framesPerChunk) writeChunk();
+    }
+    writeChunk();
+}
+
+void TrajectoryWriter::writeChunk() {
+    if (chunkFrames == 0) return;
+
+    const size_t values = size_t(chunkFrames) * bodyCount;
+    uLongf packedSize[TRAJECTORY_COLUMNS];
+    int status[TRAJECTORY_COLUMNS];
+
+    // Columns compress independently, so spread them over the available cores
+    #pragma omp parallel for schedule(dynamic)
+    for (int c = 0; c < (int)TRAJECTORY_COLUMNS; ++c) {
+        shuffleBytes(chunkColumns[c].data(), values, shuffled[c].data());
+        packedSize[c] = (uLongf)compressed[c].size();
+        status[c] = compress2(compressed[c].data(), &packedSize[c], shuffled[c].data(), (uLong)(values * sizeof(double)), Z_BEST_SPEED);
+    }
+
+    // A chunk with a column missing would end the file for readers, so leave the whole chunk out
+    for (uint32_t c = 0; c < TRAJECTORY_COLUMNS; ++c) {
+        if (status[c] == Z_OK) continue;
+        if (failedChunks++ == 0) cerr << "Trajectory: compression failed (zlib error " << status[c] << "), frames dropped" << endl;
+        dropped.fetch_add(chunkFrames, memory_order_relaxed);
+        chunkTimes.clear();
+        chunkFrames = 0;
+        return;
+    }
+
+    TrajectoryChunkHeader header = { chunkFrames, TRAJECTORY_COLUMNS };
+    out.write((const char*)&header, sizeof(header));
+    out.write((const char*)chunkTimes.data(), (streamsize)(chunkTimes.size() * sizeof(double)));
+    for (uint32_t c = 0; c < TRAJECTORY_COLUMNS; ++c) {
+        uint64_t sizes[2] = { values * sizeof(double), packedSize[c] };
+        out.write((const char*)sizes, sizeof(sizes));
+        out.write((const char*)compressed[c].data(), (streamsize)packedSize[c]);
+    }
+
+    written.fetch_add(chunkFrames, memory_order_relaxed);
+    chunkTimes.clear();
+    chunkFrames = 0;
+}
+
+bool TrajectoryReader::open(const string& path) {
+    in.open(path, ios::binary);
+    if (!in) {
+        cerr << "Could not open trajectory file: " << path << endl;
+        return false;
+    }
+    in.read((char*)&hdr, sizeof(hdr));
+    if (!in || memcmp(hdr.magic, TRAJECTORY_MAGIC, sizeof(TRAJECTORY_MAGIC)) != 0) {
+        cerr << "Not a trajectory file: " << path << endl;
+        return false;
+    }
+    if (hdr.version != TRAJECTORY_VERSION || hdr.columnCount != TRAJECTORY_COLUMNS) {
+        cerr << "Unsupported trajectory version " << hdr.version << ": " << path << endl;
+        return false;
+    }
+    return true;
+}
+
+bool TrajectoryReader::nextChunk(vector<double>& times, vector<double> (&columns)[TRAJECTORY_COLUMNS]) {
+    TrajectoryChunkHeader header;
+    if (!in.read((char*)&header, sizeof(header))) return false;
+
+    times.resize(header.frameCount);
+    in.read((char*)times.data(), (streamsize)(times.size() * sizeof(double)));
+
+    const size_t values = size_t(header.frameCount) * hdr.bodyCount;
+    for (uint32_t c = 0; c < TRAJECTORY_COLUMNS; ++c) {
+        uint64_t sizes[2];
+        in.read((char*)sizes, sizeof(sizes));
+        packed.resize(sizes[1]);
+        in.read((char*)packed.data(), (streamsize)packed.size());
+
+        shuffled.resize(sizes[0]);
+        uLongf rawSize = (uLongf)sizes[0];
+        if (!in || uncompress(shuffled.data(), &rawSize, packed.data(), (uLong)packed.size()) != Z_OK || rawSize != values * sizeof(double)) {
+            cerr << "Corrupt trajectory chunk" << endl;
+            return false;
+        }
+        columns[c].resize(values);
+        unshuffleBytes(shuffled.data(), values, columns[c].data());
+    }
+    return true;
+}
@@ -0,0 +1,145 @@
+#include "transport.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef COSMOS_MPI
+#include <mpi.h>
+#endif
+
+using namespace std;
+
+// Pairwise schedule: in round k every rank sends to rank + k and receives from rank - k
+bool Transport::allToAll(const vector<vector<char>>& outgoing, vector<vector<char>>& incoming) {
+    const int p = size(), r = rank();
+    incoming.assign(p, {});
+    incoming[r] = outgoing[r];
+    for (int k = 1; k < p; ++k) {
+        int to = (r + k) % p, from = (r - k + p) % p;
+        if (!exchange(to, outgoing[to], from, incoming[from])) return false;
+    }
+    return true;
+}
+
+bool Transport::allGather(const vector<char>& mine, vector<vector<char>>& all) {
+    return allToAll(vector<vector<char>>(size(), mine), all);
+}
+
+vector<unique_ptr<SocketTransport>> SocketTransport::createLocal(int n) {
+    vector<unique_ptr<SocketTransport>> endpoints;
+    for (int r = 0; r < n; ++r) {
+        endpoints.push_back(unique_ptr<SocketTransport>(new SocketTransport()));
+        endpoints[r]->me = r;
+        endpoints[r]->peers.assign(n, -1);
+    }
+    for (int a = 0; a < n; ++a) {
+        for (int b = a + 1; b < n; ++b) {
+            int fds[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+                cerr << "socketpair failed: " << strerror(errno) << endl;
+                return {};
+            }
+            endpoints[a]->peers[b] = fds[0];
+            endpoints[b]->peers[a] = fds[1];
+        }
+    }
+    return endpoints;
+}
+
+SocketTransport::~SocketTransport() {
+    for (int fd : peers) {
+        if (fd >= 0) ::close(fd);
+    }
+}
+
+// Each message is a uint64 length followed by the bytes. Sending and receiving progress together
+// under poll(), so two ranks sending each other more than a socket buffer cannot deadlock.
+bool SocketTransport::exchange(int to, const vector<char>& out, int from, vector<char>& in) {
+    const int sendFd = peers[to], recvFd = peers[from];
+    uint64_t outSize = out.size(), inSize = 0;
+    size_t sent = 0, received = 0;                 // counted over header + payload
+    const size_t sendTotal = sizeof(outSize) + out.size();
+    bool haveSize = false;
+    in.clear();
+
+    while (sent < sendTotal || !haveSize || received < sizeof(inSize) + inSize) {
+        pollfd fds[2];
+        int count = 0;
+        bool recvDone = haveSize && received == sizeof(inSize) + inSize;
+        if (sendFd == recvFd) {
+            fds[count++] = { sendFd, (short)((sent < sendTotal ? POLLOUT : 0) | (recvDone ? 0 : POLLIN)), 0 };
+        } else {
+            if (sent < sendTotal) fds[count++] = { sendFd, POLLOUT, 0 };
+            if (!recvDone) fds[count++] = { recvFd, POLLIN, 0 };
+        }
+        if (poll(fds, count, -1) < 0) {
+            if (errno == EINTR) continue;
+            cerr << "poll failed: " << strerror(errno) << endl;
+            return false;
+        }
+
+        for (int k = 0; k < count; ++k) {
+            if (fds[k].revents & (POLLERR | POLLNVAL)) {
+                cerr << "Transport connection failed" << endl;
+                return false;
+            }
+            if ((fds[k].revents & POLLOUT) && sent < sendTotal) {
+                const char* src = sent < sizeof(outSize) ? (const char*)&outSize + sent : out.data() + (sent - sizeof(outSize));
+                size_t len = sent < sizeof(outSize) ? sizeof(outSize) - sent : sendTotal - sent;
+                ssize_t n = ::send(fds[k].fd, src, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+                if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    cerr << "send failed: " << strerror(errno) << endl;
+                    return false;
+                }
+                if (n > 0) sent += (size_t)n;
+            }
+            if ((fds[k].revents & (POLLIN | POLLHUP)) && !(haveSize && received == sizeof(inSize) + inSize)) {
+                char* dst = received < sizeof(inSize) ? (char*)&inSize + received : in.data() + (received - sizeof(inSize));
+                size_t len = received < sizeof(inSize) ? sizeof(inSize) - received : sizeof(inSize) + inSize - received;
+                ssize_t n = ::recv(fds[k].fd, dst, len, MSG_DONTWAIT);
+                if (n == 0) {
+                    cerr << "Transport peer closed the connection" << endl;
+                    return false;
+                }
+                if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    cerr << "recv failed: " << strerror(errno) << endl;
+                    return false;
+                }
+                if (n > 0) received += (size_t)n;
+                if (!haveSize && received == sizeof(inSize)) {
+                    haveSize = true;
+                    in.resize(inSize);
+                }
+            }
+        }
+    }
+    return true;
+}
+
+#ifdef COSMOS_MPI
+MpiTransport::MpiTransport() {
+    MPI_Comm_rank(MPI_COMM_WORLD, &me);
+    MPI_Comm_size(MPI_COMM_WORLD, &count);
+}
+
+bool MpiTransport::exchange(int to, const vector<char>& out, int from, vector<char>& in) {
+    uint64_t outSize = out.size(), inSize = 0;
+    MPI_Sendrecv(&outSize, 1, MPI_UINT64_T, to, 0, &inSize, 1, MPI_UINT64_T, from, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    in.resize(inSize);
+    // MPI counts are int; large blobs go across in chunks
+    const uint64_t chunk = 1ull << 30;
+    for (uint64_t off = 0; off < max(outSize, inSize); off += chunk) {
+        int sendCount = (int)(off < outSize ? min(chunk, outSize - off) : 0);
+        int recvCount = (int)(off < inSize ? min(chunk, inSize - off) : 0);
+        MPI_Sendrecv(out.data() + min(off, outSize), sendCount, MPI_BYTE, to, 1,
+                     in.data() + min(off, inSize), recvCount, MPI_BYTE, from, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    }
+    return true;
+}
+#endif
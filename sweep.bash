@@ -0,0 +1,4 @@
+g++ src/sweep.cpp src/physicsEngine.cpp src/testParticles.cpp src/mortonOrder.cpp src/collisions.cpp src/kepler.cpp src/scenario.cpp src/snapshot.cpp -o build/sweep -Iinclude -fopenmp -O2 -pthread
+
+# Arguments go to the sweep, e.g. --scale Jupiter.mass=0.5,1,2 --dt 3600,86400 --out build/sweep.csv
+./build/sweep "$@"